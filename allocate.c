@@ -27,20 +27,33 @@
 #include "expression.h"
 #include "linearize.h"
 
+struct allocator_struct *all_allocators;
+
 void protect_allocations(struct allocator_struct *desc)
 {
 	desc->blobs = NULL;
 }
 
-void drop_all_allocations(struct allocator_struct *desc)
+/*
+ * Reset the allocator before the blobs are freed.  The caller has to save
+ * desc->blobs first.
+ */
+void forget_allocations(struct allocator_struct *desc)
 {
-	struct allocation_blob *blob = desc->blobs;
-
+	desc->dropped_allocations += desc->allocations;
+	desc->dropped_bytes += desc->useful_bytes;
 	desc->blobs = NULL;
 	desc->allocations = 0;
 	desc->total_bytes = 0;
 	desc->useful_bytes = 0;
 	desc->freelist = NULL;
+}
+
+void drop_all_allocations(struct allocator_struct *desc)
+{
+	struct allocation_blob *blob = desc->blobs;
+
+	forget_allocations(desc);
 	while (blob) {
 		struct allocation_blob *next = blob->next;
 		blob_free(blob, desc->chunking);
@@ -88,6 +101,13 @@ void *allocate(struct allocator_struct *desc, unsigned int size)
 		if (!newblob)
 			die("out of memory");
 		desc->total_bytes += chunking;
+		if (desc->total_bytes > desc->peak_bytes)
+			desc->peak_bytes = desc->total_bytes;
+		if (!desc->registered) {
+			desc->registered = 1;
+			desc->next = all_allocators;
+			all_allocators = desc;
+		}
 		newblob->next = blob;
 		blob = newblob;
 		desc->blobs = newblob;
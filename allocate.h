@@ -15,10 +15,22 @@ struct allocator_struct {
 	void *freelist;
 	/* statistics */
 	unsigned int allocations, total_bytes, useful_bytes;
+	/*
+	 * These survive drop_all_allocations():  what was allocated before
+	 * the last drop, and the high water mark of total_bytes.
+	 */
+	unsigned long long dropped_allocations, dropped_bytes;
+	unsigned int peak_bytes;
+	int registered;
+	struct allocator_struct *next;
 };
 
+/* every allocator which has been used, for the statistics */
+extern struct allocator_struct *all_allocators;
+
 extern void protect_allocations(struct allocator_struct *desc);
 extern void drop_all_allocations(struct allocator_struct *desc);
+extern void forget_allocations(struct allocator_struct *desc);
 extern void *allocate(struct allocator_struct *desc, unsigned int size);
 extern void free_one_entry(struct allocator_struct *desc, void *entry);
 extern void show_allocations(struct allocator_struct *);
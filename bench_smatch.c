@@ -0,0 +1,285 @@
+/*
+ * smatch/bench_smatch.c
+ *
+ * Copyright (C) 2013 Oracle.
+ *
+ * Licensed under the Open Software License version 1.1
+ *
+ */
+
+/*
+ * Time the state list and range list primitives on their own.
+ *
+ * usage:  bench_smatch [-n iterations] [-s size[,size...]] [test...]
+ *
+ * The inputs are built the same way every time so the numbers only change
+ * when the code does.  Only the primitive itself is timed, building the
+ * inputs and freeing everything afterwards is not.
+ *
+ * This links against smatch.c (with main() renamed, see the Makefile) so
+ * everything is set up the same as in the real program.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "smatch.h"
+#include "smatch_slist.h"
+#include "smatch_extra.h"
+
+static int iterations = 100;
+
+struct bench {
+	const char *name;
+	void (*setup)(int size);
+	void (*run)(void);
+	void (*teardown)(void);
+};
+
+static struct state_list *slist_one, *slist_two, *slist_result;
+static struct range_list *rl_one, *rl_two, *rl_result;
+static struct sm_state *merged_sm;
+static struct state_list_stack *true_stack, *false_stack;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000.0 + ts.tv_nsec;
+}
+
+static sval_t val(long long v)
+{
+	return sval_type_val(&llong_ctype, v);
+}
+
+/* "v00000" = offset, "v00001" = offset + 1, ... */
+static struct state_list *make_slist(int size, int offset)
+{
+	struct state_list *slist = NULL;
+	char name[32];
+	int i;
+
+	for (i = 0; i < size; i++) {
+		snprintf(name, sizeof(name), "v%05d", i);
+		set_state_slist(&slist, SMATCH_EXTRA, name, NULL,
+				alloc_estate_sval(val(i + offset)));
+	}
+	return slist;
+}
+
+static void free_everything(void)
+{
+	slist_one = slist_two = slist_result = NULL;
+	rl_one = rl_two = rl_result = NULL;
+	merged_sm = NULL;
+	free_function_arena();
+}
+
+static void setup_merge_slist(int size)
+{
+	slist_one = make_slist(size, 0);
+	slist_two = make_slist(size, 1);
+}
+
+static void run_merge_slist(void)
+{
+	merge_slist(&slist_one, slist_two);
+}
+
+static void teardown_slists(void)
+{
+	free_slist(&slist_one);
+	free_slist(&slist_two);
+	free_everything();
+}
+
+/* filter out every other state */
+static void setup_filter_slist(int size)
+{
+	struct sm_state *sm;
+	int i = 0;
+
+	slist_one = make_slist(size, 0);
+	slist_two = NULL;
+	FOR_EACH_PTR(slist_one, sm) {
+		if (i++ & 1)
+			add_ptr_list(&slist_two, sm);
+	} END_FOR_EACH_PTR(sm);
+}
+
+static void run_filter_slist(void)
+{
+	filter_slist(&slist_one, slist_two);
+}
+
+/* [0-2],[4-6],... and [1-3],[5-7],... so everything overlaps */
+static void setup_rls(int size)
+{
+	int i;
+
+	rl_one = rl_two = NULL;
+	for (i = 0; i < size; i++) {
+		add_range(&rl_one, val(i * 4), val(i * 4 + 2));
+		add_range(&rl_two, val(i * 4 + 1), val(i * 4 + 3));
+	}
+}
+
+static void run_rl_union(void)
+{
+	rl_result = rl_union(rl_one, rl_two);
+}
+
+static void run_rl_intersection(void)
+{
+	rl_result = rl_intersection(rl_one, rl_two);
+}
+
+/* ranges spread out over the whole long long range so they get truncated */
+static void setup_cast_rl(int size)
+{
+	long long step = 0x7fffffffffffffffLL / (size + 1);
+	int i;
+
+	rl_one = NULL;
+	for (i = 0; i < size; i++)
+		add_range(&rl_one, val(step * i), val(step * i + 5));
+}
+
+static void run_cast_rl(void)
+{
+	rl_result = cast_rl(&int_ctype, rl_one);
+}
+
+static void teardown_rls(void)
+{
+	free_everything();
+}
+
+/*
+ * Merge "size" paths where "x" is 0, 1, 2... so "x" ends up as a tree with
+ * "size" leaves and then split it on "x < size / 2".
+ */
+static void setup_separate_pools(int size)
+{
+	struct state_list *slist;
+	int i;
+
+	slist_one = NULL;
+	for (i = 0; i < size; i++) {
+		slist = make_slist(16, i);
+		set_state_slist(&slist, SMATCH_EXTRA, "x", NULL,
+				alloc_estate_sval(val(i)));
+		merge_slist(&slist_one, slist);
+		free_slist(&slist);
+	}
+	merged_sm = get_sm_state_slist(slist_one, SMATCH_EXTRA, "x", NULL);
+	rl_one = alloc_rl(val(size / 2), val(size / 2));
+}
+
+static void run_separate_pools(void)
+{
+	true_stack = false_stack = NULL;
+	__separate_pools(merged_sm, '<', rl_one, &true_stack, &false_stack);
+}
+
+static void teardown_separate_pools(void)
+{
+	free_stack(&true_stack);
+	free_stack(&false_stack);
+	free_slist(&slist_one);
+	free_everything();
+}
+
+static struct bench benches[] = {
+	{ "merge_slist", setup_merge_slist, run_merge_slist, teardown_slists },
+	{ "filter_slist", setup_filter_slist, run_filter_slist, teardown_slists },
+	{ "rl_union", setup_rls, run_rl_union, teardown_rls },
+	{ "rl_intersection", setup_rls, run_rl_intersection, teardown_rls },
+	{ "cast_rl", setup_cast_rl, run_cast_rl, teardown_rls },
+	{ "separate_pools", setup_separate_pools, run_separate_pools, teardown_separate_pools },
+};
+
+static void run_bench(struct bench *bench, int size)
+{
+	double start, total = 0;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		bench->setup(size);
+		start = now();
+		bench->run();
+		total += now() - start;
+		bench->teardown();
+	}
+	printf("%-16s %6d %8d %14.1f\n", bench->name, size, iterations,
+	       total / iterations);
+	fflush(stdout);
+}
+
+static void usage(void)
+{
+	int i;
+
+	printf("usage:  bench_smatch [-n iterations] [-s size[,size...]] [test...]\n");
+	printf("tests:");
+	for (i = 0; i < ARRAY_SIZE(benches); i++)
+		printf(" %s", benches[i].name);
+	printf("\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int sizes[32] = { 8, 32, 128 };
+	int nr_sizes = 3;
+	char *sizes_str = NULL, *p;
+	int selected[ARRAY_SIZE(benches)] = { 0 };
+	int any_selected = 0;
+	int i, j;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+			if (iterations < 1)
+				usage();
+			continue;
+		}
+		if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+			sizes_str = argv[++i];
+			continue;
+		}
+		for (j = 0; j < ARRAY_SIZE(benches); j++) {
+			if (!strcmp(argv[i], benches[j].name))
+				break;
+		}
+		if (j == ARRAY_SIZE(benches))
+			usage();
+		selected[j] = 1;
+		any_selected = 1;
+	}
+
+	if (sizes_str) {
+		nr_sizes = 0;
+		for (p = strtok(sizes_str, ","); p; p = strtok(NULL, ",")) {
+			if (nr_sizes == ARRAY_SIZE(sizes) || atoi(p) < 1)
+				usage();
+			sizes[nr_sizes++] = atoi(p);
+		}
+	}
+
+	sm_outfd = stdout;
+	init_symbols();
+	init_ctype();
+	add_merge_hook(SMATCH_EXTRA, &merge_estates);
+
+	printf("%-16s %6s %8s %14s\n", "test", "size", "iters", "ns/op");
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		if (any_selected && !selected[i])
+			continue;
+		for (j = 0; j < nr_sizes; j++)
+			run_bench(&benches[i], sizes[j]);
+	}
+	return 0;
+}
@@ -13,84 +13,113 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <assert.h>
-#include <libxml/parser.h>
-#include <libxml/tree.h>
+#include <libxml/xmlwriter.h>
 
 #include "expression.h"
 #include "parse.h"
 #include "scope.h"
 #include "symbol.h"
 
-static xmlDocPtr doc = NULL;       /* document pointer */
-static xmlNodePtr root_node = NULL;/* root node pointer */
+/*
+ * The output is streamed with an xmlTextWriter so it doesn't wait for the
+ * end of the file and memory doesn't grow with the output.  An element has
+ * to be finished before the next top level one starts, so a base type which
+ * is seen for the first time inside another symbol gets its id straight
+ * away and is written at the top level once the current symbol is done.
+ */
+static xmlTextWriterPtr writer = NULL;
 static int idcount = 0;
 
-static void examine_symbol(struct symbol *sym, xmlNodePtr node);
+static struct symbol **pending;
+static int pending_head, pending_tail, pending_alloc;
+
+static void examine_symbol(struct symbol *sym);
+
+/* sym->aux is the id + 1 once the symbol has one */
+static int sym_id(struct symbol *sym)
+{
+	return (int)(unsigned long)sym->aux - 1;
+}
+
+static int new_sym_id(struct symbol *sym)
+{
+	sym->aux = (void *)(unsigned long)(idcount + 1);
+	return idcount++;
+}
 
-static xmlAttrPtr newProp(xmlNodePtr node, const char *name, const char *value)
+static void newProp(const char *name, const char *value)
 {
-	return xmlNewProp(node, BAD_CAST name, BAD_CAST value);
+	xmlTextWriterWriteAttribute(writer, BAD_CAST name, BAD_CAST value);
 }
 
-static xmlAttrPtr newNumProp(xmlNodePtr node, const char *name, int value)
+static void newNumProp(const char *name, int value)
 {
-	char buf[256];
-	snprintf(buf, 256, "%d", value);
-	return newProp(node, name, buf);
+	xmlTextWriterWriteFormatAttribute(writer, BAD_CAST name, "%d", value);
 }
 
-static xmlAttrPtr newIdProp(xmlNodePtr node, const char *name, unsigned int id)
+static void newIdProp(const char *name, unsigned int id)
 {
-	char buf[256];
-	snprintf(buf, 256, "_%d", id);
-	return newProp(node, name, buf);
+	xmlTextWriterWriteFormatAttribute(writer, BAD_CAST name, "_%d", id);
 }
 
-static xmlNodePtr new_sym_node(struct symbol *sym, const char *name, xmlNodePtr parent)
+static void new_sym_node(struct symbol *sym, const char *name)
 {
-	xmlNodePtr node;
 	const char *ident = show_ident(sym->ident);
 
 	assert(name != NULL);
 	assert(sym != NULL);
-	assert(parent != NULL);
 
-	node = xmlNewChild(parent, NULL, BAD_CAST "symbol", NULL);
+	xmlTextWriterStartElement(writer, BAD_CAST "symbol");
 
-	newProp(node, "type", name);
+	newProp("type", name);
 
-	newIdProp(node, "id", idcount);
+	newIdProp("id", sym->aux ? sym_id(sym) : new_sym_id(sym));
 
 	if (sym->ident && ident)
-		newProp(node, "ident", ident);
-	newProp(node, "file", stream_name(sym->pos.stream));
+		newProp("ident", ident);
+	newProp("file", stream_name(sym->pos.stream));
 
-	newNumProp(node, "start-line", sym->pos.line);
-	newNumProp(node, "start-col", sym->pos.pos);
+	newNumProp("start-line", sym->pos.line);
+	newNumProp("start-col", sym->pos.pos);
 
 	if (sym->endpos.type) {
-		newNumProp(node, "end-line", sym->endpos.line);
-		newNumProp(node, "end-col", sym->endpos.pos);
+		newNumProp("end-line", sym->endpos.line);
+		newNumProp("end-col", sym->endpos.pos);
 		if (sym->pos.stream != sym->endpos.stream)
-			newProp(node, "end-file", stream_name(sym->endpos.stream));
+			newProp("end-file", stream_name(sym->endpos.stream));
         }
-	sym->aux = node;
+}
 
-	idcount++;
+static void add_pending(struct symbol *sym)
+{
+	if (pending_tail == pending_alloc) {
+		pending_alloc = pending_alloc ? pending_alloc * 2 : 64;
+		pending = realloc(pending, pending_alloc * sizeof(*pending));
+		if (!pending)
+			die("out of memory");
+	}
+	pending[pending_tail++] = sym;
+	new_sym_id(sym);
+}
 
-	return node;
+static void write_pending(void)
+{
+	while (pending_head < pending_tail)
+		examine_symbol(pending[pending_head++]);
+	pending_head = pending_tail = 0;
 }
 
-static inline void examine_members(struct symbol_list *list, xmlNodePtr node)
+static inline void examine_members(struct symbol_list *list)
 {
 	struct symbol *sym;
 
 	FOR_EACH_PTR(list, sym) {
-		examine_symbol(sym, node);
+		if (sym && !sym->aux)
+			examine_symbol(sym);
 	} END_FOR_EACH_PTR(sym);
 }
 
-static void examine_modifiers(struct symbol *sym, xmlNodePtr node)
+static void examine_modifiers(struct symbol *sym)
 {
 	const char *modifiers[] = {
 			"auto",
@@ -134,72 +163,73 @@ static void examine_modifiers(struct symbol *sym, xmlNodePtr node)
 	/*iterate over the 32 bit bitfield*/
 	for (i=0; i < 32; i++) {
 		if ((sym->ctype.modifiers & 1<<i) && modifiers[i])
-			newProp(node, modifiers[i], "1");
+			newProp(modifiers[i], "1");
 	}
 }
 
 static void
-examine_layout(struct symbol *sym, xmlNodePtr node)
+examine_layout(struct symbol *sym)
 {
 	examine_symbol_type(sym);
 
-	newNumProp(node, "bit-size", sym->bit_size);
-	newNumProp(node, "alignment", sym->ctype.alignment);
-	newNumProp(node, "offset", sym->offset);
+	newNumProp("bit-size", sym->bit_size);
+	newNumProp("alignment", sym->ctype.alignment);
+	newNumProp("offset", sym->offset);
 	if (is_bitfield_type(sym)) {
-		newNumProp(node, "bit-offset", sym->bit_offset);
+		newNumProp("bit-offset", sym->bit_offset);
 	}
 }
 
-static void examine_symbol(struct symbol *sym, xmlNodePtr node)
+/*
+ * Writes the symbol with its members nested inside it.  Symbols which were
+ * given an id by add_pending() are only written from write_pending().
+ */
+static void examine_symbol(struct symbol *sym)
 {
-	xmlNodePtr child = NULL;
+	struct symbol *base_type;
 	const char *base;
 	int array_size;
 
 	if (!sym)
 		return;
-	if (sym->aux)		/*already visited */
-		return;
 
 	if (sym->ident && sym->ident->reserved)
 		return;
 
-	child = new_sym_node(sym, get_type_name(sym->type), node);
-	examine_modifiers(sym, child);
-	examine_layout(sym, child);
-
-	if (sym->ctype.base_type) {
-		if ((base = builtin_typename(sym->ctype.base_type)) == NULL) {
-			if (!sym->ctype.base_type->aux) {
-				examine_symbol(sym->ctype.base_type, root_node);
-			}
-			xmlNewProp(child, BAD_CAST "base-type",
-			           xmlGetProp((xmlNodePtr)sym->ctype.base_type->aux, BAD_CAST "id"));
+	new_sym_node(sym, get_type_name(sym->type));
+	examine_modifiers(sym);
+	examine_layout(sym);
+
+	base_type = sym->ctype.base_type;
+	if (base_type) {
+		if ((base = builtin_typename(base_type)) == NULL) {
+			if (!base_type->aux)
+				add_pending(base_type);
+			newIdProp("base-type", sym_id(base_type));
 		} else {
-			newProp(child, "base-type-builtin", base);
+			newProp("base-type-builtin", base);
 		}
 	}
 	if (sym->array_size) {
 		/* TODO: modify get_expression_value to give error return */
 		array_size = get_expression_value(sym->array_size);
-		newNumProp(child, "array-size", array_size);
+		newNumProp("array-size", array_size);
 	}
 
 
 	switch (sym->type) {
 	case SYM_STRUCT:
 	case SYM_UNION:
-		examine_members(sym->symbol_list, child);
+		examine_members(sym->symbol_list);
 		break;
 	case SYM_FN:
-		examine_members(sym->arguments, child);
+		examine_members(sym->arguments);
 		break;
 	case SYM_UNINITIALIZED:
-		newProp(child, "base-type-builtin", builtin_typename(sym));
+		newProp("base-type-builtin", builtin_typename(sym));
 		break;
 	}
-	return;
+	xmlTextWriterEndElement(writer);
 }
 
 static struct position *get_expansion_end (struct token *token)
@@ -216,7 +246,7 @@ static struct position *get_expansion_end (struct token *token)
 		return NULL;
 }
 
-static void examine_macro(struct symbol *sym, xmlNodePtr node)
+static void examine_macro(struct symbol *sym)
 {
 	struct position *pos;
 
@@ -227,7 +257,8 @@ static void examine_macro(struct symbol *sym, xmlNodePtr node)
 	else
 		sym->endpos = sym->pos;
 
-	new_sym_node(sym, "macro", node);
+	new_sym_node(sym, "macro");
+	xmlTextWriterEndElement(writer);
 }
 
 static void examine_namespace(struct symbol *sym)
@@ -237,12 +268,15 @@ static void examine_namespace(struct symbol *sym)
 
 	switch(sym->namespace) {
 	case NS_MACRO:
-		examine_macro(sym, root_node);
+		if (!sym->aux)
+			examine_macro(sym);
 		break;
 	case NS_TYPEDEF:
 	case NS_STRUCT:
 	case NS_SYMBOL:
-		examine_symbol(sym, root_node);
+		if (!sym->aux)
+			examine_symbol(sym);
+		write_pending();
 		break;
 	case NS_NONE:
 	case NS_LABEL:
@@ -286,9 +320,13 @@ int main(int argc, char **argv)
 	struct symbol_list *symlist = NULL;
 	char *file;
 
-	doc = xmlNewDoc(BAD_CAST "1.0");
-	root_node = xmlNewNode(NULL, BAD_CAST "parse");
-	xmlDocSetRootElement(doc, root_node);
+	writer = xmlNewTextWriterFilename("-", 0);
+	if (!writer)
+		die("cannot write to stdout");
+	xmlTextWriterSetIndent(writer, 1);
+	xmlTextWriterSetIndentString(writer, BAD_CAST "  ");
+	xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL);
+	xmlTextWriterStartElement(writer, BAD_CAST "parse");
 
 /* - A DTD is probably unnecessary for something like this
 
@@ -308,10 +346,10 @@ int main(int argc, char **argv)
 	} END_FOR_EACH_PTR_NOTAG(file);
 
 
-	xmlSaveFormatFileEnc("-", doc, "UTF-8", 1);
-	xmlFreeDoc(doc);
+	xmlTextWriterEndDocument(writer);
+	xmlFreeTextWriter(writer);
 	xmlCleanupParser();
+	free(pending);
 
 	return 0;
 }
-
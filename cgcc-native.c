@@ -0,0 +1,938 @@
+/*
+ * smatch/cgcc-native.c
+ *
+ * Copyright (C) 2013 Oracle.
+ *
+ * Licensed under the Open Software License version 1.1
+ *
+ */
+
+/*
+ * A C version of the cgcc Perl wrapper for builds with a lot of files.
+ * It takes the same options and environment variables and runs the
+ * checker and the compiler the same way, but without a Perl interpreter
+ * and a shell for every compile.
+ *
+ * The host specs and the "cc -print-file-name=" result are cached in
+ * $CGCC_CACHE (~/.cache/cgcc by default, set it to "" to turn it off).
+ * The file name is a hash of everything which goes into them: REAL_CC and
+ * the size and mtime of the compiler binary, uname, -m32 and -m64.
+ *
+ * With CGCC_BATCH=<file> the checker isn't run at all.  The command is
+ * appended to <file> and "cgcc-native -flush-batch=<file>" runs it later.
+ * Commands with the same directory and options are joined into one
+ * checker run with up to CGCC_BATCH_MAX files (64 by default).  -jN runs
+ * N checkers at a time and the output is printed in order.  For smatch use
+ * CHECK="smatch --snapshot" so the files don't see each other's
+ * declarations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+struct args {
+	char **argv;
+	int nr, alloc;
+};
+
+static struct args cc, check_opts, host_specs;
+static int m32, m64;
+static int verbose;
+
+static void die(const char *fmt, const char *arg)
+{
+	fprintf(stderr, "cgcc-native: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static void add_arg(struct args *args, const char *arg)
+{
+	if (args->nr + 2 > args->alloc) {
+		args->alloc = args->alloc ? args->alloc * 2 : 64;
+		args->argv = realloc(args->argv, args->alloc * sizeof(char *));
+		if (!args->argv)
+			die("out of memory%s", "");
+	}
+	args->argv[args->nr++] = strdup(arg);
+	args->argv[args->nr] = NULL;
+}
+
+static void add_argf(struct args *args, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void add_argf(struct args *args, const char *fmt, ...)
+{
+	char buf[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	add_arg(args, buf);
+}
+
+static void add_args(struct args *to, struct args *from)
+{
+	int i;
+
+	for (i = 0; i < from->nr; i++)
+		add_arg(to, from->argv[i]);
+}
+
+/* REAL_CC and CHECK can have options in them, "ccache gcc" for example */
+static void add_words(struct args *args, const char *str)
+{
+	char *copy = strdup(str);
+	char *word;
+
+	for (word = strtok(copy, " \t"); word; word = strtok(NULL, " \t"))
+		add_arg(args, word);
+	free(copy);
+}
+
+/* The same as cgcc's check_only_option() */
+static int check_only_option(const char *arg)
+{
+	static const char *warnings[] = {
+		"default-bitfield-sign", "one-bit-signed-bitfield",
+		"cast-truncate", "bitwise", "typesign", "context", "undef",
+		"ptr-subtraction-blows", "cast-to-as", "decl",
+		"transparent-union", "address-space", "enum-mismatch",
+		"do-while", "old-initializer", "non-pointer-null",
+		"paren-string", "return-void", "designated-init", "sparse-all",
+	};
+	int i;
+
+	if (!strncmp(arg, "-W", 2)) {
+		arg += 2;
+		if (!strncmp(arg, "no-", 3))
+			arg += 3;
+		else if (!strncmp(arg, "no", 2))
+			arg += 2;
+		for (i = 0; i < sizeof(warnings) / sizeof(warnings[0]); i++) {
+			if (!strcmp(arg, warnings[i]))
+				return 1;
+		}
+		return 0;
+	}
+	if (!strncmp(arg, "-v", 2)) {
+		arg += 2;
+		if (!strncmp(arg, "no-", 3))
+			arg += 3;
+		else if (!strncmp(arg, "no", 2))
+			arg += 2;
+		return !strcmp(arg, "entry") || !strcmp(arg, "dead");
+	}
+	return 0;
+}
+
+static int is_c_file(const char *arg)
+{
+	int len = strlen(arg);
+
+	return arg[0] != '-' && len > 2 && !strcmp(arg + len - 2, ".c");
+}
+
+/* The specs, these have to match add_specs() in cgcc. */
+
+static const char *pow2m1(int bits)
+{
+	switch (bits) {
+	case 8: return "127";
+	case 16: return "32767";
+	case 32: return "2147483647";
+	case 64: return "9223372036854775807";
+	case 128: return "170141183460469231731687303715884105727";
+	}
+	die("weird number of bits.%s", "");
+	return NULL;
+}
+
+static void integer_types(struct args *args, int nr, const int *bits)
+{
+	static const char *names[] = { "SCHAR", "SHRT", "INT", "LONG", "LONG_LONG", "LONG_LONG_LONG" };
+	static const char *suffixes[] = { "", "", "", "L", "LL", "LLL" };
+	int i;
+
+	/* cgcc starts the types at the char bits too so SCHAR is 8 bits */
+	add_argf(args, "-D__CHAR_BIT__=%d", bits[0]);
+	for (i = 0; i < nr; i++)
+		add_argf(args, "-D__%s_MAX__=%s%s", names[i], pow2m1(bits[i]),
+			 suffixes[i]);
+}
+
+struct float_consts {
+	int mant_bits;
+	const char *min, *max, *epsilon, *denorm_min;
+};
+
+static const struct float_consts float_consts[] = {
+	{ 24, "1.17549435e-38", "3.40282347e+38", "1.19209290e-7",
+	  "1.40129846e-45" },
+	{ 53, "2.2250738585072014e-308", "1.7976931348623157e+308",
+	  "2.2204460492503131e-16", "4.9406564584124654e-324" },
+	{ 64, "3.36210314311209350626e-4932", "1.18973149535723176502e+4932",
+	  "1.08420217248550443401e-19", "3.64519953188247460253e-4951" },
+	{ 113, "3.36210314311209350626267781732175260e-4932",
+	  "1.18973149535723176508575932662800702e+4932",
+	  "1.92592994438723585305597794258492732e-34",
+	  "6.47517511943802511092443895822764655e-4966" },
+};
+
+/* log10(2) the way Perl's log(2) / log(10) works it out */
+static int int_log10_2(int n)
+{
+	return (int)(n * 0.30102999566398119521);
+}
+
+static void float_types(struct args *args, int has_inf, int has_qnan,
+			int dec_dig, const int bits[3][2])
+{
+	static const char *names[] = { "FLT", "DBL", "LDBL" };
+	static const char *suffixes[] = { "F", "", "L" };
+	const struct float_consts *h;
+	int mant_bits, exp_bits, max_exp, min_exp;
+	int i, j;
+
+	add_arg(args, "-D__FLT_RADIX__=2");
+	add_argf(args, "-D__FINITE_MATH_ONLY__=%d", has_inf || has_qnan ? 0 : 1);
+	add_argf(args, "-D__DECIMAL_DIG__=%d", dec_dig);
+
+	for (i = 0; i < 3; i++) {
+		mant_bits = bits[i][0];
+		exp_bits = bits[i][1];
+		h = NULL;
+		for (j = 0; j < sizeof(float_consts) / sizeof(float_consts[0]); j++) {
+			if (float_consts[j].mant_bits == mant_bits)
+				h = &float_consts[j];
+		}
+		if (!h)
+			die("weird number of mantissa bits.%s", "");
+
+		max_exp = 1 << (exp_bits - 1);
+		min_exp = 3 - max_exp;
+		add_argf(args, "-D__%s_MANT_DIG__=%d", names[i], mant_bits);
+		add_argf(args, "-D__%s_DIG__=%d", names[i], int_log10_2(mant_bits - 1));
+		add_argf(args, "-D__%s_MIN_EXP__=(%d)", names[i], min_exp);
+		add_argf(args, "-D__%s_MAX_EXP__=%d", names[i], max_exp);
+		add_argf(args, "-D__%s_MIN_10_EXP__=(%d)", names[i], -int_log10_2(-min_exp));
+		add_argf(args, "-D__%s_MAX_10_EXP__=%d", names[i], int_log10_2(max_exp));
+		add_argf(args, "-D__%s_HAS_INFINITY__=%d", names[i], has_inf);
+		add_argf(args, "-D__%s_HAS_QUIET_NAN__=%d", names[i], has_qnan);
+		/* sorted by name like the Perl version */
+		add_argf(args, "-D__%s_DENORM_MIN__=%s%s", names[i], h->denorm_min, suffixes[i]);
+		add_argf(args, "-D__%s_EPSILON__=%s%s", names[i], h->epsilon, suffixes[i]);
+		add_argf(args, "-D__%s_MAX__=%s%s", names[i], h->max, suffixes[i]);
+		add_argf(args, "-D__%s_MIN__=%s%s", names[i], h->min, suffixes[i]);
+	}
+}
+
+static void define_size_t(struct args *args, const char *text)
+{
+	/* We have to undef in order to override check's internal definition. */
+	add_arg(args, "-U__SIZE_TYPE__");
+	add_argf(args, "-D__SIZE_TYPE__=%s", text);
+}
+
+static void add_specs(struct args *args, const char *spec)
+{
+	static const int bits_i86[3][2] = { { 24, 8 }, { 53, 11 }, { 64, 15 } };
+	static const int bits_113[3][2] = { { 24, 8 }, { 53, 11 }, { 113, 15 } };
+	const char *size_t_32 = m64 ? "long unsigned int" : "unsigned int";
+	int ints[6] = { 8, 16, 32, m64 ? 64 : 32, 64, 128 };
+
+	if (!strcmp(spec, "sunos")) {
+		add_specs(args, "unix");
+		add_arg(args, "-D__sun__=1");
+		add_arg(args, "-D__sun=1");
+		add_arg(args, "-Dsun=1");
+		add_arg(args, "-D__svr4__=1");
+		add_arg(args, "-DSVR4=1");
+		add_arg(args, "-D__STDC__=0");
+		add_arg(args, "-D_REENTRANT");
+		add_arg(args, "-D_SOLARIS_THREADS");
+		add_arg(args, "-DNULL=((void *)0)");
+	} else if (!strcmp(spec, "linux")) {
+		add_specs(args, "unix");
+		add_arg(args, "-D__linux__=1");
+		add_arg(args, "-D__linux=1");
+		add_arg(args, "-Dlinux=linux");
+	} else if (!strcmp(spec, "openbsd")) {
+		add_specs(args, "unix");
+		add_arg(args, "-D__OpenBSD__=1");
+	} else if (!strcmp(spec, "unix")) {
+		add_arg(args, "-Dunix=1");
+		add_arg(args, "-D__unix=1");
+		add_arg(args, "-D__unix__=1");
+	} else if (!strncmp(spec, "cygwin", 6)) {
+		add_specs(args, "unix");
+		add_arg(args, "-D__CYGWIN__=1");
+		add_arg(args, "-D__CYGWIN32__=1");
+		add_arg(args, "-D_cdecl=__attribute__((__cdecl__))");
+		add_arg(args, "-D__cdecl=__attribute__((__cdecl__))");
+		add_arg(args, "-D_stdcall=__attribute__((__stdcall__))");
+		add_arg(args, "-D__stdcall=__attribute__((__stdcall__))");
+		add_arg(args, "-D_fastcall=__attribute__((__fastcall__))");
+		add_arg(args, "-D__fastcall=__attribute__((__fastcall__))");
+		add_arg(args, "-D__declspec(x)=__attribute__((x))");
+	} else if (!strcmp(spec, "i86")) {
+		add_arg(args, "-Di386=1");
+		add_arg(args, "-D__i386=1");
+		add_arg(args, "-D__i386__=1");
+		integer_types(args, 5, ints);
+		float_types(args, 1, 1, 21, bits_i86);
+		define_size_t(args, size_t_32);
+	} else if (!strcmp(spec, "sparc")) {
+		add_arg(args, "-Dsparc=1");
+		add_arg(args, "-D__sparc=1");
+		add_arg(args, "-D__sparc__=1");
+		integer_types(args, 5, ints);
+		float_types(args, 1, 1, 33, bits_113);
+		define_size_t(args, size_t_32);
+	} else if (!strcmp(spec, "sparc64")) {
+		int ints64[6] = { 8, 16, 32, 64, 64, 128 };
+
+		add_arg(args, "-Dsparc=1");
+		add_arg(args, "-D__sparc=1");
+		add_arg(args, "-D__sparc__=1");
+		add_arg(args, "-D__sparcv9__=1");
+		add_arg(args, "-D__sparc64__=1");
+		add_arg(args, "-D__arch64__=1");
+		add_arg(args, "-D__LP64__=1");
+		integer_types(args, 6, ints64);
+		float_types(args, 1, 1, 33, bits_113);
+		define_size_t(args, "long unsigned int");
+	} else if (!strcmp(spec, "x86_64")) {
+		int ints64[6] = { 8, 16, 32, m32 ? 32 : 64, 64, 128 };
+
+		add_arg(args, "-Dx86_64=1");
+		add_arg(args, "-D__x86_64=1");
+		add_arg(args, "-D__x86_64__=1");
+		if (!m32)
+			add_arg(args, "-D__LP64__=1");
+		integer_types(args, 6, ints64);
+		float_types(args, 1, 1, 33, bits_113);
+		define_size_t(args, m32 ? "unsigned int" : "long unsigned int");
+	} else if (!strcmp(spec, "ppc")) {
+		add_arg(args, "-D__powerpc__=1");
+		add_arg(args, "-D_BIG_ENDIAN");
+		add_arg(args, "-D_STRING_ARCH_unaligned=1");
+		integer_types(args, 5, ints);
+		float_types(args, 1, 1, 21, bits_113);
+		define_size_t(args, size_t_32);
+	} else if (!strcmp(spec, "host_os_specs")) {
+		struct utsname uts;
+		char os[sizeof(uts.sysname)];
+		int i;
+
+		if (uname(&uts) < 0)
+			return;
+		for (i = 0; uts.sysname[i]; i++)
+			os[i] = tolower(uts.sysname[i]);
+		os[i] = '\0';
+		add_specs(args, os);
+	} else if (!strcmp(spec, "host_arch_specs")) {
+		struct utsname uts;
+		const char *arch;
+
+		if (uname(&uts) < 0)
+			return;
+		arch = uts.machine;
+		if (!strcasecmp(arch, "athlon") ||
+		    (tolower(arch[0]) == 'i' && strlen(arch) <= 4 &&
+		     !strcmp(arch + strlen(arch) - 2, "86")))
+			add_specs(args, "i86");
+		else if (!strcasecmp(arch, "sun4u"))
+			add_specs(args, "sparc");
+		else if (!strcasecmp(arch, "x86_64"))
+			add_specs(args, "x86_64");
+		else if (!strcasecmp(arch, "ppc"))
+			add_specs(args, "ppc");
+		else if (!strcasecmp(arch, "sparc64"))
+			add_specs(args, "sparc64");
+	} else {
+		die("invalid specs: %s", spec);
+	}
+}
+
+/* The host specs cache */
+
+static unsigned long long hash_str(unsigned long long hash, const char *str)
+{
+	while (*str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 0x100000001b3ULL;
+	}
+	hash ^= 0xff;
+	hash *= 0x100000001b3ULL;
+	return hash;
+}
+
+static void compiler_fingerprint(struct args *real_cc, char *buf, int len)
+{
+	const char *path = getenv("PATH");
+	const char *name = real_cc->argv[0];
+	char full[4096];
+	struct stat st;
+	const char *p, *end;
+
+	memset(&st, 0, sizeof(st));
+	if (strchr(name, '/')) {
+		stat(name, &st);
+	} else {
+		for (p = path ? path : ""; *p; p = *end ? end + 1 : end) {
+			end = strchr(p, ':');
+			if (!end)
+				end = p + strlen(p);
+			snprintf(full, sizeof(full), "%.*s/%s", (int)(end - p), p, name);
+			if (stat(full, &st) == 0)
+				break;
+		}
+	}
+	snprintf(buf, len, "%lld.%lld.%lld", (long long)st.st_ino,
+		 (long long)st.st_size, (long long)st.st_mtime);
+}
+
+static char *cache_file_name(const char *key)
+{
+	const char *dir = getenv("CGCC_CACHE");
+	const char *home = getenv("HOME");
+	static char buf[4096];
+
+	if (dir && !*dir)
+		return NULL;
+	if (!dir) {
+		if (!home)
+			return NULL;
+		snprintf(buf, sizeof(buf), "%s/.cache", home);
+		mkdir(buf, 0755);
+		snprintf(buf, sizeof(buf), "%s/.cache/cgcc", home);
+		mkdir(buf, 0755);
+	} else {
+		snprintf(buf, sizeof(buf), "%s", dir);
+		mkdir(buf, 0755);
+	}
+	snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "/%016llx",
+		 hash_str(0xcbf29ce484222325ULL, key));
+	return buf;
+}
+
+/* The first line is the whole key in case two hashes are the same. */
+static int load_cache(const char *file, const char *key, struct args *args)
+{
+	char line[4096];
+	FILE *f;
+	int len;
+
+	f = fopen(file, "r");
+	if (!f)
+		return 0;
+	if (!fgets(line, sizeof(line), f) || strncmp(line, key, strlen(key)) ||
+	    line[strlen(key)] != '\n') {
+		fclose(f);
+		return 0;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		len = strlen(line);
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		add_arg(args, line);
+	}
+	fclose(f);
+	return 1;
+}
+
+static void save_cache(const char *file, const char *key, struct args *args)
+{
+	char tmp[4096 + 32];
+	FILE *f;
+	int i;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", file, getpid());
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+	fprintf(f, "%s\n", key);
+	for (i = 0; i < args->nr; i++)
+		fprintf(f, "%s\n", args->argv[i]);
+	if (fclose(f) || rename(tmp, file))
+		unlink(tmp);
+}
+
+static char *print_file_name(struct args *real_cc)
+{
+	static char buf[4096];
+	struct args args = {};
+	int fds[2];
+	int status, len = 0, ret;
+	pid_t pid;
+
+	add_args(&args, real_cc);
+	if (m32)
+		add_arg(&args, "-m32");
+	if (m64)
+		add_arg(&args, "-m64");
+	add_arg(&args, "-print-file-name=");
+
+	if (pipe(fds) < 0)
+		return NULL;
+	pid = fork();
+	if (pid < 0)
+		return NULL;
+	if (pid == 0) {
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execvp(args.argv[0], args.argv);
+		_exit(127);
+	}
+	close(fds[1]);
+	while (len < sizeof(buf) - 1 &&
+	       (ret = read(fds[0], buf + len, sizeof(buf) - 1 - len)) > 0)
+		len += ret;
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+	while (len && isspace((unsigned char)buf[len - 1]))
+		len--;
+	buf[len] = '\0';
+	return len ? buf : NULL;
+}
+
+/* everything uname and "cc -print-file-name=" say, cached if we can */
+static void get_host_specs(struct args *real_cc, const char *gcc_base_dir)
+{
+	struct utsname uts;
+	char key[4096], fingerprint[128];
+	char *file;
+
+	memset(&uts, 0, sizeof(uts));
+	uname(&uts);
+	compiler_fingerprint(real_cc, fingerprint, sizeof(fingerprint));
+	snprintf(key, sizeof(key), "1 %s %s %s %d %d %s %s", uts.sysname,
+		 uts.machine, fingerprint, m32, m64,
+		 gcc_base_dir ? gcc_base_dir : "-", getenv("REAL_CC") ? getenv("REAL_CC") : "cc");
+	file = cache_file_name(key);
+	if (file && load_cache(file, key, &host_specs))
+		return;
+
+	add_specs(&host_specs, "host_arch_specs");
+	add_specs(&host_specs, "host_os_specs");
+	if (!gcc_base_dir)
+		gcc_base_dir = print_file_name(real_cc);
+	if (gcc_base_dir) {
+		add_arg(&host_specs, "-gcc-base-dir");
+		add_arg(&host_specs, gcc_base_dir);
+	}
+	if (file)
+		save_cache(file, key, &host_specs);
+}
+
+/* Running things */
+
+static void print_args(FILE *f, struct args *args)
+{
+	const char *p;
+	int i;
+
+	for (i = 0; i < args->nr; i++) {
+		if (i)
+			fputc(' ', f);
+		for (p = args->argv[i]; *p; p++) {
+			if (!isalnum((unsigned char)*p) && !strchr("-._/,=", *p))
+				fputc('\\', f);
+			fputc(*p, f);
+		}
+		if (!args->argv[i][0])
+			fputs("''", f);
+	}
+	fputc('\n', f);
+}
+
+static void run(struct args *args, int wait_for_it)
+{
+	int status;
+	pid_t pid;
+
+	fflush(stdout);
+	if (!wait_for_it) {
+		execvp(args->argv[0], args->argv);
+		die("cannot run %s", args->argv[0]);
+	}
+	pid = fork();
+	if (pid < 0)
+		die("fork() failed%s", "");
+	if (pid == 0) {
+		execvp(args->argv[0], args->argv);
+		fprintf(stderr, "cgcc-native: cannot run %s\n", args->argv[0]);
+		_exit(127);
+	}
+	waitpid(pid, &status, 0);
+}
+
+/* The batch file */
+
+/*
+ * The checker ignores where the object and the dependency files go but
+ * they're different for every file so leave them out of the batch or
+ * nothing would ever be batched together.  Returns how many arguments to
+ * skip.
+ */
+static int output_only_option(struct args *args, int i)
+{
+	const char *arg = args->argv[i];
+
+	if (!strcmp(arg, "-o") || !strcmp(arg, "-MF") || !strcmp(arg, "-MQ") ||
+	    !strcmp(arg, "-MT"))
+		return i + 1 < args->nr ? 2 : 1;
+	if (!strncmp(arg, "-o", 2) || !strncmp(arg, "-M", 2) ||
+	    !strncmp(arg, "-Wp,-M", 6))
+		return 1;
+	return 0;
+}
+
+/*
+ * A record is the directory, the options and the files, each one followed
+ * by a NUL and the lists ended by an empty string.  It's written with one
+ * write() under a lock so parallel makes don't mix them up.
+ */
+static void append_batch(const char *file, struct args *args)
+{
+	char cwd[4096];
+	char *buf;
+	int len = 0, alloc, i, skip, pass, fd;
+
+	if (!getcwd(cwd, sizeof(cwd)))
+		die("getcwd() failed%s", "");
+
+	alloc = strlen(cwd) + 3;
+	for (i = 0; i < args->nr; i++)
+		alloc += strlen(args->argv[i]) + 1;
+	buf = malloc(alloc);
+	if (!buf)
+		die("out of memory%s", "");
+
+	strcpy(buf, cwd);
+	len = strlen(cwd) + 1;
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < args->nr; i++) {
+			skip = output_only_option(args, i);
+			if (skip) {
+				i += skip - 1;
+				continue;
+			}
+			if (is_c_file(args->argv[i]) != pass)
+				continue;
+			strcpy(buf + len, args->argv[i]);
+			len += strlen(args->argv[i]) + 1;
+		}
+		buf[len++] = '\0';
+	}
+
+	fd = open(file, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (fd < 0)
+		die("cannot open %s", file);
+	flock(fd, LOCK_EX);
+	if (write(fd, buf, len) != len)
+		die("cannot write to %s", file);
+	flock(fd, LOCK_UN);
+	close(fd);
+	free(buf);
+}
+
+struct batch {
+	char *cwd;
+	struct args args;
+	struct args files;
+	char *key;
+	FILE *out;
+	pid_t pid;
+	int done;
+};
+
+static struct batch *batches;
+static int nr_batches, alloc_batches;
+
+static char *next_str(char **p, char *end)
+{
+	char *str = *p;
+
+	if (*p >= end)
+		die("corrupt batch file%s", "");
+	*p += strlen(str) + 1;
+	return str;
+}
+
+static void read_batch(const char *file, int max_files)
+{
+	struct batch *batch;
+	char *data, *p, *end, *str;
+	struct args args, files;
+	struct stat st;
+	char *key;
+	int fd, keylen, i, j;
+
+	fd = open(file, O_RDWR);
+	if (fd < 0)
+		die("cannot open %s", file);
+	flock(fd, LOCK_EX);
+	if (fstat(fd, &st) < 0)
+		die("cannot stat %s", file);
+	data = malloc(st.st_size + 1);
+	if (!data || read(fd, data, st.st_size) != st.st_size)
+		die("cannot read %s", file);
+	/* it's all in memory now, the next build can start a new one */
+	if (ftruncate(fd, 0) < 0)
+		die("cannot truncate %s", file);
+	flock(fd, LOCK_UN);
+	close(fd);
+
+	p = data;
+	end = data + st.st_size;
+	while (p < end) {
+		char *cwd = next_str(&p, end);
+
+		memset(&args, 0, sizeof(args));
+		memset(&files, 0, sizeof(files));
+		keylen = strlen(cwd) + 1;
+		while (*(str = next_str(&p, end))) {
+			add_arg(&args, str);
+			keylen += strlen(str) + 1;
+		}
+		while (*(str = next_str(&p, end)))
+			add_arg(&files, str);
+
+		key = malloc(keylen + 1);
+		strcpy(key, cwd);
+		for (i = 0; i < args.nr; i++) {
+			strcat(key, "\x1f");
+			strcat(key, args.argv[i]);
+		}
+
+		for (i = 0; i < files.nr; i++) {
+			batch = NULL;
+			for (j = nr_batches - 1; j >= 0; j--) {
+				if (!strcmp(batches[j].key, key)) {
+					batch = &batches[j];
+					break;
+				}
+			}
+			if (!batch || batch->files.nr >= max_files) {
+				if (nr_batches == alloc_batches) {
+					alloc_batches = alloc_batches ? alloc_batches * 2 : 64;
+					batches = realloc(batches, alloc_batches * sizeof(*batches));
+				}
+				batch = &batches[nr_batches++];
+				memset(batch, 0, sizeof(*batch));
+				batch->cwd = cwd;
+				batch->key = key;
+				add_args(&batch->args, &args);
+			}
+			add_arg(&batch->files, files.argv[i]);
+		}
+	}
+}
+
+static void start_batch(struct batch *batch, struct args *checker)
+{
+	struct args args = {};
+	int i;
+
+	add_args(&args, checker);
+	add_args(&args, &batch->args);
+	add_args(&args, &batch->files);
+	if (verbose)
+		print_args(stdout, &args);
+
+	batch->out = tmpfile();
+	if (!batch->out)
+		die("cannot create a temporary file%s", "");
+	fflush(stdout);
+	fflush(stderr);
+	batch->pid = fork();
+	if (batch->pid < 0)
+		die("fork() failed%s", "");
+	if (batch->pid == 0) {
+		dup2(fileno(batch->out), STDOUT_FILENO);
+		dup2(fileno(batch->out), STDERR_FILENO);
+		if (chdir(batch->cwd) < 0)
+			die("cannot chdir to %s", batch->cwd);
+		execvp(args.argv[0], args.argv);
+		fprintf(stderr, "cgcc-native: cannot run %s\n", args.argv[0]);
+		_exit(127);
+	}
+	for (i = 0; i < args.nr; i++)
+		free(args.argv[i]);
+	free(args.argv);
+}
+
+static void print_batch(struct batch *batch)
+{
+	char buf[4096];
+	size_t size;
+
+	rewind(batch->out);
+	while ((size = fread(buf, 1, sizeof(buf), batch->out)) > 0)
+		fwrite(buf, 1, size, stdout);
+	fclose(batch->out);
+	batch->out = NULL;
+}
+
+static int flush_batch(const char *file, int jobs)
+{
+	struct args checker = {};
+	const char *max_str = getenv("CGCC_BATCH_MAX");
+	int max_files = max_str ? atoi(max_str) : 64;
+	int started = 0, printed = 0, running = 0;
+	int status, failed = 0;
+	pid_t pid;
+	int i;
+
+	add_words(&checker, getenv("CHECK") ? getenv("CHECK") : "sparse");
+	if (max_files < 1)
+		max_files = 64;
+	if (jobs < 1)
+		jobs = 1;
+	read_batch(file, max_files);
+
+	while (printed < nr_batches) {
+		while (running < jobs && started < nr_batches) {
+			start_batch(&batches[started++], &checker);
+			running++;
+		}
+		pid = wait(&status);
+		if (pid < 0)
+			break;
+		for (i = 0; i < started; i++) {
+			if (batches[i].pid == pid) {
+				batches[i].done = 1;
+				running--;
+				if (!WIFEXITED(status) || WEXITSTATUS(status))
+					failed = 1;
+			}
+		}
+		/* print in the order of the build */
+		while (printed < started && batches[printed].done)
+			print_batch(&batches[printed++]);
+	}
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	struct args real_cc = {};
+	const char *gcc_base_dir = NULL;
+	const char *batch_file = getenv("CGCC_BATCH");
+	int has_specs = 0, gendeps = 0, do_check = 0, do_compile = 1;
+	int from_stdin = 0;
+	int i;
+
+	if (argc >= 2 && !strncmp(argv[1], "-flush-batch=", 13)) {
+		int jobs = 1;
+
+		for (i = 2; i < argc; i++) {
+			if (!strncmp(argv[i], "-j", 2))
+				jobs = atoi(argv[i] + 2);
+			if (!strcmp(argv[i], "-v"))
+				verbose = 1;
+		}
+		return flush_batch(argv[1] + 13, jobs);
+	}
+
+	add_words(&real_cc, getenv("REAL_CC") ? getenv("REAL_CC") : "cc");
+	add_args(&cc, &real_cc);
+
+	for (i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+
+		/*
+		 * Look for a .c file.  We don't want to run the checker on .o
+		 * or .so files in the link run.  Ditto for stdin.
+		 */
+		if (is_c_file(arg))
+			do_check = 1;
+		if (!strcmp(arg, "-"))
+			do_check = from_stdin = 1;
+		if (!strcmp(arg, "-m32"))
+			m32 = 1;
+		if (!strcmp(arg, "-m64"))
+			m64 = 1;
+		if (!strcmp(arg, "-M"))
+			gendeps = 1;
+
+		if (!strncmp(arg, "-target=", 8)) {
+			add_specs(&check_opts, arg + 8);
+			has_specs = 1;
+			continue;
+		}
+		if (!strcmp(arg, "-no-compile")) {
+			do_compile = 0;
+			continue;
+		}
+		if (!strcmp(arg, "-gcc-base-dir")) {
+			if (++i >= argc)
+				die("missing argument for -gcc-base-dir option%s", "");
+			gcc_base_dir = argv[i];
+			continue;
+		}
+		/* If someone adds "-E", don't pre-process twice. */
+		if (!strcmp(arg, "-E"))
+			do_compile = 0;
+		if (!strcmp(arg, "-v"))
+			verbose = 1;
+
+		if (!check_only_option(arg))
+			add_arg(&cc, arg);
+		add_arg(&check_opts, arg);
+	}
+
+	if (gendeps) {
+		do_compile = 1;
+		do_check = 0;
+	}
+
+	if (do_check) {
+		if (!has_specs) {
+			get_host_specs(&real_cc, gcc_base_dir);
+			add_args(&check_opts, &host_specs);
+		} else {
+			if (!gcc_base_dir)
+				gcc_base_dir = print_file_name(&real_cc);
+			if (gcc_base_dir) {
+				add_arg(&check_opts, "-gcc-base-dir");
+				add_arg(&check_opts, gcc_base_dir);
+			}
+		}
+
+		/* the checker comes from CHECK when the batch is flushed */
+		if (batch_file && *batch_file && !from_stdin) {
+			append_batch(batch_file, &check_opts);
+		} else {
+			struct args check = {};
+
+			add_words(&check, getenv("CHECK") ? getenv("CHECK") : "sparse");
+			add_args(&check, &check_opts);
+			if (verbose)
+				print_args(stdout, &check);
+			run(&check, do_compile);
+		}
+	}
+
+	if (do_compile) {
+		if (verbose)
+			print_args(stdout, &cc);
+		run(&cc, 0);
+	}
+	return 0;
+}
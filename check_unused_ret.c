@@ -31,6 +31,10 @@
  * are called in smatch_flow.c.  (If the order changed it
  * would break).
  *
+ * With --two-passes loop bodies are parsed twice.  An assignment
+ * gets the same ID both times so a use which is only reached on
+ * the next time around the loop still counts.
+ *
  */
 
 #include "smatch.h"
@@ -44,6 +48,7 @@ struct assignment {
 	char *name;
 	char *function;
 	int line;
+	int used;
 };
 ALLOCATOR(assignment, "assignment id");
 DECLARE_PTR_LIST(assignment_list, struct assignment);
@@ -88,13 +93,23 @@ static int ignored_function(struct expression *expr)
 	return ret;
 }
 
+static struct assignment *find_assignment(const char *name, int line)
+{
+	struct assignment *tmp;
+
+	FOR_EACH_PTR(assignment_list, tmp) {
+		if (tmp->line == line && strcmp(tmp->name, name) == 0)
+			return tmp;
+	} END_FOR_EACH_PTR(tmp);
+	return NULL;
+}
+
 static void match_assign_call(struct expression *expr)
 {
 	struct expression *left;
 	struct assignment *assign;
+	char *name;
 
-	if (final_pass)
-		return;
 	if (in_condition())
 		return;
 	if (expr->op != '=')
@@ -111,13 +126,24 @@ static void match_assign_call(struct expression *expr)
 
 	skip_this = left;
 
+	name = expr_to_var(left);
+	if (!name)
+		return;
+	assign = find_assignment(name, get_lineno());
+	if (assign) {
+		free_string(name);
+		set_state_expr(my_id, left, alloc_state_num(assign->assign_id));
+		return;
+	}
+
 	set_state_expr(my_id, left, alloc_state_num(assign_id));
 
 	assign = __alloc_assignment(0);
 	assign->assign_id = assign_id++;
-	assign->name = expr_to_var(left);
+	assign->name = name;
 	assign->function = get_fn_name(expr->right);
 	assign->line = get_lineno();
+	assign->used = 0;
 	add_ptr_list(&assignment_list, assign);
 }
 
@@ -139,7 +165,7 @@ static void delete_used(int assign_id)
 
  	FOR_EACH_PTR(assignment_list, tmp) {
 		if (tmp->assign_id == assign_id) {
-			DELETE_CURRENT_PTR(tmp);
+			tmp->used = 1;
 			return;
 		}
 	} END_FOR_EACH_PTR(tmp);
@@ -175,6 +201,8 @@ static void match_end_func(struct symbol *sym)
 	if (__inline_fn)
 		return;
  	FOR_EACH_PTR(assignment_list, tmp) {
+		if (tmp->used)
+			continue;
 		sm_printf("%s:%d %s ", get_filename(), tmp->line, get_function());
 		sm_printf("warn: unused return: %s = %s()\n",
 			tmp->name, tmp->function);
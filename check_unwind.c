@@ -57,6 +57,9 @@ static void print_unwind_functions(const char *fn, struct expression *expr, void
 		return;
 	if (last_printed == cur_func_sym)
 		return;
+	/* the loop pre-passes are quiet, wait for the real pass */
+	if (!final_pass)
+		return;
 	last_printed = cur_func_sym;
 	sm_msg("info: is unwind function");
 }
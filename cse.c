@@ -17,11 +17,28 @@
 #include "linearize.h"
 #include "flow.h"
 
-#define INSN_HASH_SIZE 256
-static struct instruction_list *insn_hash_table[INSN_HASH_SIZE];
+/*
+ * The hash table is open addressed and every slot is a list of the
+ * instructions which looked the same when they were added.  It starts at
+ * INSN_HASH_MIN slots and doubles when it gets over half full so big
+ * functions don't end up with long lists to sort.
+ */
+#define INSN_HASH_MIN 256
+
+struct insn_hash_slot {
+	unsigned long hash;
+	struct instruction_list *insns;
+};
+
+static struct insn_hash_slot *insn_hash_table;
+static unsigned long insn_hash_size;
+static unsigned long insn_hash_used;
 
 int repeat_phase;
 
+/* CSE doesn't change the flow graph so this lasts until the next round */
+static int dominators_valid;
+
 static int phi_compare(pseudo_t phi1, pseudo_t phi2)
 {
 	const struct instruction *def1 = phi1->def;
@@ -35,6 +52,81 @@ static int phi_compare(pseudo_t phi1, pseudo_t phi2)
 }
 
 
+static int insn_compare(const void *_i1, const void *_i2);
+
+static inline unsigned long hash_mix(unsigned long hash, unsigned long val)
+{
+	return hash ^ (val + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+static inline unsigned long hash_final(unsigned long hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static void alloc_insn_hash(unsigned long size)
+{
+	insn_hash_table = calloc(size, sizeof(*insn_hash_table));
+	if (!insn_hash_table)
+		die("out of memory");
+	insn_hash_size = size;
+	insn_hash_used = 0;
+}
+
+static struct insn_hash_slot *find_insn_slot(unsigned long hash, struct instruction *insn)
+{
+	unsigned long mask = insn_hash_size - 1;
+	unsigned long i = hash & mask;
+	struct insn_hash_slot *slot;
+
+	for (;;) {
+		slot = &insn_hash_table[i];
+		if (!slot->insns)
+			return slot;
+		if (slot->hash == hash && !insn_compare(first_instruction(slot->insns), insn))
+			return slot;
+		i = (i + 1) & mask;
+	}
+}
+
+static void grow_insn_hash(void)
+{
+	struct insn_hash_slot *old = insn_hash_table;
+	unsigned long old_size = insn_hash_size;
+	struct insn_hash_slot *slot;
+	unsigned long i;
+
+	alloc_insn_hash(old_size * 2);
+	for (i = 0; i < old_size; i++) {
+		if (!old[i].insns)
+			continue;
+		slot = find_insn_slot(old[i].hash, first_instruction(old[i].insns));
+		*slot = old[i];
+		insn_hash_used++;
+	}
+	free(old);
+}
+
+static void add_insn_hash(unsigned long hash, struct instruction *insn)
+{
+	struct insn_hash_slot *slot;
+
+	if (!insn_hash_table)
+		alloc_insn_hash(INSN_HASH_MIN);
+	if ((insn_hash_used + 1) * 2 > insn_hash_size)
+		grow_insn_hash();
+
+	slot = find_insn_slot(hash, insn);
+	if (!slot->insns) {
+		slot->hash = hash;
+		insn_hash_used++;
+	}
+	add_instruction(&slot->insns, insn);
+}
+
 static void clean_up_one_instruction(struct basic_block *bb, struct instruction *insn)
 {
 	unsigned long hash;
@@ -43,10 +135,10 @@ static void clean_up_one_instruction(struct basic_block *bb, struct instruction
 		return;
 	assert(insn->bb == bb);
 	repeat_phase |= simplify_instruction(insn);
-	hash = (insn->opcode << 3) + (insn->size >> 3);
+	hash = hash_mix(insn->opcode, insn->size);
 	switch (insn->opcode) {
 	case OP_SEL:
-		hash += hashval(insn->src3);
+		hash = hash_mix(hash, hashval(insn->src3));
 		/* Fall through */	
 
 	/* Binary arithmetic */
@@ -68,20 +160,20 @@ static void clean_up_one_instruction(struct basic_block *bb, struct instruction
 	case OP_SET_LT: case OP_SET_GT:
 	case OP_SET_B:  case OP_SET_A:
 	case OP_SET_BE: case OP_SET_AE:
-		hash += hashval(insn->src2);
+		hash = hash_mix(hash, hashval(insn->src2));
 		/* Fall through */
 	
 	/* Unary */
 	case OP_NOT: case OP_NEG:
-		hash += hashval(insn->src1);
+		hash = hash_mix(hash, hashval(insn->src1));
 		break;
 
 	case OP_SETVAL:
-		hash += hashval(insn->val);
+		hash = hash_mix(hash, hashval(insn->val));
 		break;
 
 	case OP_SYMADDR:
-		hash += hashval(insn->symbol);
+		hash = hash_mix(hash, hashval(insn->symbol));
 		break;
 
 	case OP_CAST:
@@ -93,8 +185,8 @@ static void clean_up_one_instruction(struct basic_block *bb, struct instruction
 		 * some kind of "type hash" that is identical
 		 * for identical casts
 		 */
-		hash += hashval(insn->orig_type);
-		hash += hashval(insn->src);
+		hash = hash_mix(hash, hashval(insn->orig_type));
+		hash = hash_mix(hash, hashval(insn->src));
 		break;
 
 	/* Other */
@@ -105,8 +197,8 @@ static void clean_up_one_instruction(struct basic_block *bb, struct instruction
 			if (phi == VOID || !phi->def)
 				continue;
 			def = phi->def;
-			hash += hashval(def->src1);
-			hash += hashval(def->bb);
+			hash = hash_mix(hash, hashval(def->src1));
+			hash = hash_mix(hash, hashval(def->bb));
 		} END_FOR_EACH_PTR(phi);
 		break;
 	}
@@ -118,9 +210,7 @@ static void clean_up_one_instruction(struct basic_block *bb, struct instruction
 		 */
 		return;
 	}
-	hash += hash >> 16;
-	hash &= INSN_HASH_SIZE-1;
-	add_instruction(insn_hash_table + hash, insn);
+	add_insn_hash(hash_final(hash), insn);
 }
 
 static void clean_up_insns(struct entrypoint *ep)
@@ -269,28 +359,6 @@ static struct instruction * cse_one_instruction(struct instruction *insn, struct
 	return def;
 }
 
-/*
- * Does "bb1" dominate "bb2"?
- */
-static int bb_dominates(struct entrypoint *ep, struct basic_block *bb1, struct basic_block *bb2, unsigned long generation)
-{
-	struct basic_block *parent;
-
-	/* Nothing dominates the entrypoint.. */
-	if (bb2 == ep->entry->bb)
-		return 0;
-	FOR_EACH_PTR(bb2->parents, parent) {
-		if (parent == bb1)
-			continue;
-		if (parent->generation == generation)
-			continue;
-		parent->generation = generation;
-		if (!bb_dominates(ep, bb1, parent, generation))
-			return 0;
-	} END_FOR_EACH_PTR(parent);
-	return 1;
-}
-
 static struct basic_block *trivial_common_parent(struct basic_block *bb1, struct basic_block *bb2)
 {
 	struct basic_block *parent;
@@ -318,7 +386,12 @@ static void add_instruction_to_end(struct instruction *insn, struct basic_block
 	add_instruction(&bb->insns, br);
 }
 
-static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction *i1, struct instruction *i2)
+/*
+ * "in_order" means i1 is known to come before i2 if they are in the same
+ * basic block.  The hash lists are filled in program order and the sort is
+ * stable so that's normally true and saves us walking the block.
+ */
+static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction *i1, struct instruction *i2, int in_order)
 {
 	struct basic_block *b1, *b2, *common;
 
@@ -335,6 +408,8 @@ static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction
 	 */
 	if (b1 == b2) {
 		struct instruction *insn;
+		if (in_order)
+			return cse_one_instruction(i2, i1);
 		FOR_EACH_PTR(b1->insns, insn) {
 			if (insn == i1)
 				return cse_one_instruction(i2, i1);
@@ -344,10 +419,14 @@ static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction
 		warning(b1->pos, "Whaa? unable to find CSE instructions");
 		return i1;
 	}
-	if (bb_dominates(ep, b1, b2, ++bb_generation))
+	if (!dominators_valid) {
+		compute_dominators(ep);
+		dominators_valid = 1;
+	}
+	if (bb_dominates(b1, b2))
 		return cse_one_instruction(i2, i1);
 
-	if (bb_dominates(ep, b2, b1, ++bb_generation))
+	if (bb_dominates(b2, b1))
 		return cse_one_instruction(i1, i2);
 
 	/* No direct dominance - but we could try to find a common ancestor.. */
@@ -363,28 +442,36 @@ static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction
 
 void cleanup_and_cse(struct entrypoint *ep)
 {
-	int i;
+	unsigned long i;
 
 	simplify_memops(ep);
 repeat:
 	repeat_phase = 0;
 	clean_up_insns(ep);
-	for (i = 0; i < INSN_HASH_SIZE; i++) {
-		struct instruction_list **list = insn_hash_table + i;
+	dominators_valid = 0;
+	for (i = 0; i < insn_hash_size; i++) {
+		struct instruction_list **list = &insn_hash_table[i].insns;
 		if (*list) {
 			if (instruction_list_size(*list) > 1) {
 				struct instruction *insn, *last;
+				struct basic_block *last_bb;
 
 				sort_instruction_list(list);
 
 				last = NULL;
+				last_bb = NULL;
 				FOR_EACH_PTR(*list, insn) {
-					if (!insn->bb)
+					struct basic_block *bb = insn->bb;
+
+					if (!bb)
 						continue;
 					if (last) {
+						/* last->bb changes if it was moved to a common parent */
 						if (!insn_compare(last, insn))
-							insn = try_to_cse(ep, last, insn);
+							insn = try_to_cse(ep, last, insn, last->bb == last_bb);
 					}
+					if (insn != last)
+						last_bb = bb;
 					last = insn;
 				} END_FOR_EACH_PTR(insn);
 			}
@@ -392,6 +479,14 @@ repeat:
 		}
 	}
 
+	/* don't keep walking a huge table for every small function after */
+	if (insn_hash_size > INSN_HASH_MIN && insn_hash_used * 8 < insn_hash_size) {
+		free(insn_hash_table);
+		insn_hash_table = NULL;
+		insn_hash_size = 0;
+	}
+	insn_hash_used = 0;
+
 	if (repeat_phase & REPEAT_SYMBOL_CLEANUP)
 		simplify_memops(ep);
 
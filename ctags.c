@@ -7,11 +7,29 @@
  *
  * Licensed under the Open Software License version 1.1
  */
+
+/*
+ * usage:  ctags [-j N] [-f tagfile] [-L listfile] [sparse options] files...
+ *
+ * -j N splits the files between N worker processes.  The -include files
+ * are parsed once and then every worker forks off with the same symbols.
+ * Each worker writes its tag lines to a temporary file and the parent
+ * merges them.
+ *
+ * The tags from a header come up again in every file which includes it so
+ * the merged lines are sorted and duplicates are dropped.  The tag file is
+ * sorted by plain byte order which is what "!_TAG_FILE_SORTED 1" means so
+ * vim and readtags can binary search it.
+ *
+ * -L reads the file names from listfile, one per line, or from stdin if
+ * listfile is "-".  -f sets the output file, "tags" by default.
+ */
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/wait.h>
 
 #include "parse.h"
 #include "scope.h"
@@ -20,29 +38,13 @@ static struct symbol_list *taglist = NULL;
 
 static void examine_symbol(struct symbol *sym);
 
-#define MAX(_x,_y) ((_x) > (_y) ? (_x) : (_y))
-
-static int cmp_sym(const void *m, const void *n)
-{
-	const struct ident *a = ((const struct symbol *)m)->ident;
-	const struct ident *b = ((const struct symbol *)n)->ident;
-	int ret = strncmp(a->name, b->name, MAX(a->len, b->len));
-	if (!ret) {
-		const struct position a_pos = ((const struct symbol *)m)->pos;
-		const struct position b_pos = ((const struct symbol *)n)->pos;
-
-		ret = strcmp(stream_name(a_pos.stream),
-		             stream_name(b_pos.stream));
-		if (!ret)
-			return a_pos.line < b_pos.line;
-	}
-	return ret;
-}
+static int jobs = 1;
+static const char *tag_file = "tags";
 
 static void show_tag_header(FILE *fp)
 {
 	fprintf(fp, "!_TAG_FILE_FORMAT\t2\t/extended format; --format=1 will not append ;\" to lines/\n");
-	fprintf(fp, "!_TAG_FILE_SORTED\t0\t/0=unsorted, 1=sorted, 2=foldcase/\n");
+	fprintf(fp, "!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted, 2=foldcase/\n");
 	fprintf(fp, "!_TAG_PROGRAM_AUTHOR\tChristopher Li\t/sparse@chrisli.org/\n");
 	fprintf(fp, "!_TAG_PROGRAM_NAME\tSparse Ctags\t//\n");
 	fprintf(fp, "!_TAG_PROGRAM_URL\thttp://www.kernel.org/pub/software/devel/sparse/\t/official site/\n");
@@ -55,33 +57,63 @@ static inline void show_symbol_tag(FILE *fp, struct symbol *sym)
 	       stream_name(sym->pos.stream), sym->pos.line, (int)sym->kind);
 }
 
-static void show_tags(struct symbol_list *list)
+static void write_tags(FILE *fp, struct symbol_list *list)
 {
 	struct symbol *sym;
-	struct ident *ident = NULL;
-	struct position pos = {};
-	static const char *filename;
+
+	FOR_EACH_PTR(list, sym) {
+		show_symbol_tag(fp, sym);
+	} END_FOR_EACH_PTR(sym);
+}
+
+static int cmp_line(const void *m, const void *n)
+{
+	return strcmp(*(char * const *)m, *(char * const *)n);
+}
+
+static void show_tags(FILE **parts, int nr_parts)
+{
+	char **lines = NULL;
+	int nr = 0, alloc = 0;
+	char *line = NULL;
+	size_t size = 0;
 	FILE *fp;
+	int i;
 
-	if (!list)
+	for (i = 0; i < nr_parts; i++) {
+		rewind(parts[i]);
+		while (getline(&line, &size, parts[i]) > 0) {
+			if (nr == alloc) {
+				alloc = alloc ? alloc * 2 : 1024;
+				lines = realloc(lines, alloc * sizeof(*lines));
+				if (!lines)
+					die("out of memory");
+			}
+			lines[nr++] = line;
+			line = NULL;
+			size = 0;
+		}
+		fclose(parts[i]);
+	}
+	free(line);
+
+	if (!nr)
 		return;
+	qsort(lines, nr, sizeof(*lines), cmp_line);
 
-	fp = fopen("tags", "w");
+	fp = fopen(tag_file, "w");
 	if (!fp) {
 		perror("open tags file");
 		return;
 	}
 	show_tag_header(fp);
-	FOR_EACH_PTR(list, sym) {
-		if (ident == sym->ident && pos.line == sym->pos.line &&
-		    !strcmp(filename, stream_name(sym->pos.stream)))
-			continue;
-
-		show_symbol_tag(fp, sym);
-		ident = sym->ident;
-		pos = sym->pos;
-		filename = stream_name(sym->pos.stream);
-	} END_FOR_EACH_PTR(sym);
+	for (i = 0; i < nr; i++) {
+		if (!i || strcmp(lines[i - 1], lines[i]))
+			fputs(lines[i], fp);
+	}
+	for (i = 0; i < nr; i++)
+		free(lines[i]);
+	free(lines);
 	fclose(fp);
 }
 
@@ -194,18 +226,139 @@ static inline void examine_symbol_list(struct symbol_list *list)
 	} END_FOR_EACH_PTR(sym);
 }
 
-int main(int argc, char **argv)
+static void tag_files(struct string_list *filelist, int worker, FILE *out)
 {
-	struct string_list *filelist = NULL;
 	char *file;
+	int i = 0;
 
-	examine_symbol_list(sparse_initialize(argc, argv, &filelist));
 	FOR_EACH_PTR_NOTAG(filelist, file) {
+		if (i++ % jobs != worker)
+			continue;
 		sparse(file);
 		examine_symbol_list(file_scope->symbols);
 	} END_FOR_EACH_PTR_NOTAG(file);
 	examine_symbol_list(global_scope->symbols);
-	sort_list((struct ptr_list **)&taglist, cmp_sym);
-	show_tags(taglist);
+	write_tags(out, taglist);
+}
+
+static void add_arg(char ***args, int *nr, int *alloc, char *arg)
+{
+	if (*nr == *alloc) {
+		*alloc = *alloc ? *alloc * 2 : 64;
+		*args = realloc(*args, *alloc * sizeof(**args));
+		if (!*args)
+			die("out of memory");
+	}
+	(*args)[(*nr)++] = arg;
+}
+
+static void read_file_list(const char *name, char ***args, int *nr, int *alloc)
+{
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	FILE *fp;
+
+	fp = strcmp(name, "-") ? fopen(name, "r") : stdin;
+	if (!fp)
+		die("cannot open file list '%s'", name);
+	while ((len = getline(&line, &size, fp)) > 0) {
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (len)
+			add_arg(args, nr, alloc, strdup(line));
+	}
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+}
+
+/* our own options come out before sparse sees the rest */
+static char **parse_args(int argc, char **argv, int *new_argc)
+{
+	char **args = NULL;
+	int nr = 0, alloc = 0;
+	const char *list = NULL;
+	int i;
+
+	add_arg(&args, &nr, &alloc, argv[0]);
+	for (i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "-j", 2)) {
+			jobs = atoi(argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : ""));
+			if (jobs < 1)
+				die("-j needs a number of workers");
+			continue;
+		}
+		if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "-L")) {
+			if (i + 1 == argc)
+				die("argument to '%s' is missing", argv[i]);
+			if (argv[i][1] == 'f')
+				tag_file = argv[++i];
+			else
+				list = argv[++i];
+			continue;
+		}
+		add_arg(&args, &nr, &alloc, argv[i]);
+	}
+	if (list)
+		read_file_list(list, &args, &nr, &alloc);
+	*new_argc = nr;
+	add_arg(&args, &nr, &alloc, NULL);
+	return args;
+}
+
+int main(int argc, char **argv)
+{
+	struct string_list *filelist = NULL;
+	FILE *part;
+	FILE **outs;
+	int status;
+	pid_t pid;
+	int i;
+
+	argv = parse_args(argc, argv, &argc);
+	examine_symbol_list(sparse_initialize(argc, argv, &filelist));
+
+	if (jobs > ptr_list_size((struct ptr_list *)filelist))
+		jobs = ptr_list_size((struct ptr_list *)filelist);
+	if (jobs <= 1) {
+		jobs = 1;
+		part = tmpfile();
+		if (!part)
+			die("cannot create a temporary file");
+		tag_files(filelist, 0, part);
+		show_tags(&part, 1);
+		return 0;
+	}
+
+	/*
+	 * Every worker starts with the tags from the -include files so they
+	 * come out once per worker but the merge drops the copies.
+	 */
+	fflush(stdout);
+	fflush(stderr);
+	outs = malloc(jobs * sizeof(*outs));
+	for (i = 0; i < jobs; i++) {
+		outs[i] = tmpfile();
+		if (!outs[i])
+			die("cannot create a temporary file");
+		pid = fork();
+		if (pid < 0)
+			die("fork() failed");
+		if (pid == 0) {
+			tag_files(filelist, i, outs[i]);
+			fflush(stdout);
+			fflush(stderr);
+			_exit(fflush(outs[i]) || ferror(outs[i]));
+		}
+	}
+	for (i = 0; i < jobs; i++) {
+		if (wait(&status) < 0)
+			break;
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			fprintf(stderr, "ctags: a worker failed.  The tags are incomplete.\n");
+	}
+	show_tags(outs, jobs);
+	free(outs);
 	return 0;
 }
@@ -732,6 +732,132 @@ static void mark_bb_reachable(struct basic_block *bb, unsigned long generation)
 	} END_FOR_EACH_PTR(child);
 }
 
+/*
+ * The dominator tree is worked out with the iterative algorithm from
+ * Cooper, Harvey and Kennedy's "A Simple, Fast Dominance Algorithm".
+ * The blocks are first numbered in postorder so "dom_nr" is the postorder
+ * number while we work it out.  Afterwards it is the number in a preorder
+ * walk of the tree and "dom_last" is the highest number under the block,
+ * so a dominance check is just two compares.
+ *
+ * It's only valid until the flow graph changes.  Blocks which can't be
+ * reached have no idom and a dom_nr of -1.
+ */
+static int dom_count, dom_alloc;
+static struct basic_block **dom_order;
+
+static void number_postorder(struct basic_block *bb, unsigned long generation)
+{
+	struct basic_block *child;
+
+	bb->generation = generation;
+	FOR_EACH_PTR(bb->children, child) {
+		if (child->generation != generation)
+			number_postorder(child, generation);
+	} END_FOR_EACH_PTR(child);
+	if (dom_count == dom_alloc) {
+		dom_alloc = dom_alloc ? dom_alloc * 2 : 64;
+		dom_order = realloc(dom_order, dom_alloc * sizeof(*dom_order));
+		if (!dom_order)
+			die("out of memory");
+	}
+	bb->dom_nr = dom_count;
+	dom_order[dom_count++] = bb;
+}
+
+static struct basic_block *intersect_dominators(struct basic_block *one, struct basic_block *two)
+{
+	while (one != two) {
+		while (one->dom_nr < two->dom_nr)
+			one = one->idom;
+		while (two->dom_nr < one->dom_nr)
+			two = two->idom;
+	}
+	return one;
+}
+
+static int number_dominator_tree(struct basic_block *bb, struct basic_block **first_child,
+	struct basic_block **next_sibling, int nr)
+{
+	struct basic_block *child, *next;
+
+	bb->dom_nr = nr++;
+	for (child = first_child[bb->dom_last]; child; child = next) {
+		next = next_sibling[child->dom_last];
+		nr = number_dominator_tree(child, first_child, next_sibling, nr);
+	}
+	bb->dom_last = nr - 1;
+	return nr;
+}
+
+void compute_dominators(struct entrypoint *ep)
+{
+	struct basic_block **first_child, **next_sibling;
+	struct basic_block *bb, *parent, *entry, *idom;
+	unsigned long generation = ++bb_generation;
+	int changed;
+	int i;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		bb->idom = NULL;
+		bb->dom_nr = -1;
+		bb->dom_last = -1;
+	} END_FOR_EACH_PTR(bb);
+
+	entry = ep->entry->bb;
+	dom_count = 0;
+	number_postorder(entry, generation);
+
+	entry->idom = entry;
+	do {
+		changed = 0;
+		/* reverse postorder, skipping the entry */
+		for (i = dom_count - 2; i >= 0; i--) {
+			bb = dom_order[i];
+			idom = NULL;
+			FOR_EACH_PTR(bb->parents, parent) {
+				if (parent->generation != generation || !parent->idom)
+					continue;
+				idom = idom ? intersect_dominators(parent, idom) : parent;
+			} END_FOR_EACH_PTR(parent);
+			if (bb->idom != idom) {
+				bb->idom = idom;
+				changed = 1;
+			}
+		}
+	} while (changed);
+
+	/* renumber in preorder, dom_last is the postorder number in the meantime */
+	first_child = calloc(dom_count * 2, sizeof(*first_child));
+	if (!first_child)
+		die("out of memory");
+	next_sibling = first_child + dom_count;
+	for (i = 0; i < dom_count; i++)
+		dom_order[i]->dom_last = dom_order[i]->dom_nr;
+	for (i = 0; i < dom_count - 1; i++) {
+		bb = dom_order[i];
+		next_sibling[i] = first_child[bb->idom->dom_last];
+		first_child[bb->idom->dom_last] = bb;
+	}
+	number_dominator_tree(entry, first_child, next_sibling, 0);
+	entry->idom = NULL;
+
+	free(first_child);
+}
+
+/*
+ * Does "dom" dominate "bb"?  Nothing dominates the entrypoint and a block
+ * that can't be reached is dominated by everything.
+ */
+int bb_dominates(struct basic_block *dom, struct basic_block *bb)
+{
+	if (bb->dom_nr < 0)
+		return 1;
+	if (!bb->idom)
+		return 0;
+	return dom->dom_nr >= 0 && dom->dom_nr <= bb->dom_nr && bb->dom_nr <= dom->dom_last;
+}
+
 static void kill_defs(struct instruction *insn)
 {
 	pseudo_t target = insn->target;
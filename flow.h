@@ -26,6 +26,9 @@ extern void kill_use(pseudo_t *);
 extern void kill_instruction(struct instruction *);
 extern void kill_unreachable_bbs(struct entrypoint *ep);
 
+extern void compute_dominators(struct entrypoint *ep);
+extern int bb_dominates(struct basic_block *dom, struct basic_block *bb);
+
 void check_access(struct instruction *insn);
 void convert_load_instruction(struct instruction *, pseudo_t);
 void rewrite_load_instruction(struct instruction *, struct pseudo_list *);
@@ -97,6 +97,7 @@ static void do_warn(const char *type, struct position pos, const char * fmt, va_
 
 static int max_warnings = 100;
 static int show_info = 1;
+unsigned int nr_diagnostics;
 
 void info(struct position pos, const char * fmt, ...)
 {
@@ -113,6 +114,7 @@ void warning(struct position pos, const char * fmt, ...)
 {
 	va_list args;
 
+	nr_diagnostics++;
 	if (!max_warnings) {
 		show_info = 0;
 		return;
@@ -131,6 +133,7 @@ void warning(struct position pos, const char * fmt, ...)
 static void do_error(struct position pos, const char * fmt, va_list args)
 {
 	static int errors = 0;
+	nr_diagnostics++;
         die_if_error = 1;
 	show_info = 1;
 	/* Shut up warnings after an error */
@@ -568,19 +571,36 @@ static char **handle_switch_ftabstop(char *arg, char **next)
 	return next;
 }
 
+static char **handle_switch_ftoken_cache(char *arg, char **next)
+{
+	if (*arg == '\0')
+		die("error: missing argument to \"-ftoken-cache=\"");
+	token_cache_dir = arg;
+	return next;
+}
+
 static char **handle_switch_f(char *arg, char **next)
 {
+	int flag = 1;
+
 	arg++;
 
 	if (!strncmp(arg, "tabstop=", 8))
 		return handle_switch_ftabstop(arg+8, next);
+	if (!strncmp(arg, "token-cache=", 12))
+		return handle_switch_ftoken_cache(arg+12, next);
 
 	/* handle switches w/ arguments above, boolean and only boolean below */
 
 	if (!strncmp(arg, "no-", 3)) {
 		arg += 3;
+		flag = 0;
 	}
 	/* handle switch here.. */
+	if (!strcmp(arg, "mmap"))
+		mmap_input = flag;
+	if (!strcmp(arg, "include-cache"))
+		include_cache = flag;
 	return next;
 }
 
@@ -233,6 +233,8 @@ struct basic_block {
 	struct basic_block_list *children; /* destinations */
 	struct instruction_list *insns;	/* Linear list of instructions */
 	struct pseudo_list *needs, *defines;
+	struct basic_block *idom;	/* immediate dominator, see compute_dominators() */
+	int dom_nr, dom_last;
 	void *priv;
 };
 
@@ -6,6 +6,9 @@
  */
 
 #include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "parse.h"
 #include "expression.h"
@@ -184,33 +187,117 @@ static inline int trackable_pseudo(pseudo_t pseudo)
 	return pseudo && (pseudo->type == PSEUDO_REG || pseudo->type == PSEUDO_ARG);
 }
 
+/*
+ * The liveness sets are bitsets while we work them out and are only turned
+ * into the bb->needs and bb->defines lists at the end.  A pseudo's bit is
+ * its argument number for PSEUDO_ARG, the PSEUDO_REG numbers come after
+ * that and start at the lowest one the function uses.  The bb->priv
+ * pointers are borrowed to find the sets for each basic block.
+ */
+#define BITS_PER_WORD	(sizeof(unsigned long) * 8)
+
+struct live_bb {
+	struct basic_block *bb;
+	void *priv;
+	unsigned long *needs;
+	unsigned long *defines;
+	int queued;
+};
+
+static struct live_bb *live_bbs;
+static int nr_live_bbs;
+static int live_words;
+static pseudo_t *live_pseudos;
+static int arg_max, reg_min, reg_max;
+
+static inline struct live_bb *get_live_bb(struct basic_block *bb)
+{
+	struct live_bb *live = bb->priv;
+
+	if (live < live_bbs || live >= live_bbs + nr_live_bbs)
+		return NULL;
+	return live;
+}
+
+static inline int pseudo_bit(pseudo_t pseudo)
+{
+	if (pseudo->type == PSEUDO_ARG)
+		return pseudo->nr - 1;
+	return arg_max + pseudo->nr - reg_min;
+}
+
+static inline void set_live_bit(unsigned long *set, pseudo_t pseudo)
+{
+	int bit = pseudo_bit(pseudo);
+
+	set[bit / BITS_PER_WORD] |= 1UL << (bit % BITS_PER_WORD);
+	live_pseudos[bit] = pseudo;
+}
+
+static void count_pseudo(struct basic_block *bb, struct instruction *insn, pseudo_t pseudo)
+{
+	if (!trackable_pseudo(pseudo))
+		return;
+	if (pseudo->type == PSEUDO_ARG) {
+		if (pseudo->nr > arg_max)
+			arg_max = pseudo->nr;
+		return;
+	}
+	if (pseudo->nr < reg_min)
+		reg_min = pseudo->nr;
+	if (pseudo->nr > reg_max)
+		reg_max = pseudo->nr;
+}
+
 static void insn_uses(struct basic_block *bb, struct instruction *insn, pseudo_t pseudo)
 {
 	if (trackable_pseudo(pseudo)) {
 		struct instruction *def = pseudo->def;
 		if (pseudo->type != PSEUDO_REG || def->bb != bb || def->opcode == OP_PHI)
-			add_pseudo_exclusive(&bb->needs, pseudo);
+			set_live_bit(get_live_bb(bb)->needs, pseudo);
 	}
 }
 
 static void insn_defines(struct basic_block *bb, struct instruction *insn, pseudo_t pseudo)
 {
+	struct live_bb *live;
+
 	assert(trackable_pseudo(pseudo));
-	add_pseudo(&bb->defines, pseudo);
+	live = get_live_bb(bb);
+	if (live)
+		set_live_bit(live->defines, pseudo);
 }
 
-static void track_bb_liveness(struct basic_block *bb)
+/* parent->needs |= child->needs & ~parent->defines */
+static int merge_live_needs(struct live_bb *parent, struct live_bb *child)
 {
-	pseudo_t needs;
+	unsigned long new;
+	int changed = 0;
+	int i;
+
+	for (i = 0; i < live_words; i++) {
+		new = child->needs[i] & ~parent->defines[i] & ~parent->needs[i];
+		if (new) {
+			parent->needs[i] |= new;
+			changed = 1;
+		}
+	}
+	return changed;
+}
 
-	FOR_EACH_PTR(bb->needs, needs) {
-		struct basic_block *parent;
-		FOR_EACH_PTR(bb->parents, parent) {
-			if (!pseudo_in_list(parent->defines, needs)) {
-				add_pseudo_exclusive(&parent->needs, needs);
-			}
-		} END_FOR_EACH_PTR(parent);
-	} END_FOR_EACH_PTR(needs);
+static void live_set_to_list(unsigned long *set, struct pseudo_list **list)
+{
+	unsigned long word;
+	int i, bit;
+
+	for (i = 0; i < live_words; i++) {
+		word = set[i];
+		while (word) {
+			bit = __builtin_ctzl(word);
+			word &= word - 1;
+			add_pseudo(list, live_pseudos[i * BITS_PER_WORD + bit]);
+		}
+	}
 }
 
 /*
@@ -227,48 +314,118 @@ void clear_liveness(struct entrypoint *ep)
 	} END_FOR_EACH_PTR(bb);
 }
 
-/*
- * Track inter-bb pseudo liveness. The intra-bb case
- * is purely local information.
- */
-void track_pseudo_liveness(struct entrypoint *ep)
+static void for_each_insn(struct entrypoint *ep,
+	void (*def)(struct basic_block *, struct instruction *, pseudo_t),
+	void (*use)(struct basic_block *, struct instruction *, pseudo_t))
 {
 	struct basic_block *bb;
 
-	/* Add all the bb pseudo usage */
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct instruction *insn;
 		FOR_EACH_PTR(bb->insns, insn) {
 			if (!insn->bb)
 				continue;
 			assert(insn->bb == bb);
-			track_instruction_usage(bb, insn, insn_defines, insn_uses);
+			track_instruction_usage(bb, insn, def, use);
 		} END_FOR_EACH_PTR(insn);
 	} END_FOR_EACH_PTR(bb);
+}
 
-	/* Calculate liveness.. */
-	do {
-		liveness_changed = 0;
-		FOR_EACH_PTR_REVERSE(ep->bbs, bb) {
-			track_bb_liveness(bb);
-		} END_FOR_EACH_PTR_REVERSE(bb);
-	} while (liveness_changed);
-
-	/* Remove the pseudos from the "defines" list that are used internally */
+/*
+ * Track inter-bb pseudo liveness. The intra-bb case
+ * is purely local information.
+ */
+void track_pseudo_liveness(struct entrypoint *ep)
+{
+	struct basic_block *bb, *parent, *child;
+	struct live_bb *live, *other;
+	unsigned long *sets, *used;
+	int *worklist;
+	int nr_work = 0;
+	int nr_bits;
+	int i, j;
+
+	nr_live_bbs = bb_list_size(ep->bbs);
+	if (!nr_live_bbs)
+		return;
+
+	/* Work out how many bits we need */
+	arg_max = 0;
+	reg_min = INT_MAX;
+	reg_max = 0;
+	for_each_insn(ep, count_pseudo, count_pseudo);
+	nr_bits = arg_max + (reg_min <= reg_max ? reg_max - reg_min + 1 : 0);
+	live_words = (nr_bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+	if (!live_words)
+		live_words = 1;
+
+	live_bbs = calloc(nr_live_bbs, sizeof(*live_bbs));
+	sets = calloc((nr_live_bbs * 2 + 1) * live_words, sizeof(*sets));
+	live_pseudos = calloc(live_words * BITS_PER_WORD, sizeof(*live_pseudos));
+	worklist = malloc(nr_live_bbs * sizeof(*worklist));
+	if (!live_bbs || !sets || !live_pseudos || !worklist)
+		die("out of memory");
+	used = sets + nr_live_bbs * 2 * live_words;
+
+	i = 0;
 	FOR_EACH_PTR(ep->bbs, bb) {
-		pseudo_t def;
-		FOR_EACH_PTR(bb->defines, def) {
-			struct basic_block *child;
-			FOR_EACH_PTR(bb->children, child) {
-				if (pseudo_in_list(child->needs, def))
-					goto is_used;
-			} END_FOR_EACH_PTR(child);
-			DELETE_CURRENT_PTR(def);
-is_used:
-		;
-		} END_FOR_EACH_PTR(def);
-		PACK_PTR_LIST(&bb->defines);
+		live = &live_bbs[i];
+		live->bb = bb;
+		live->priv = bb->priv;
+		live->needs = sets + i * 2 * live_words;
+		live->defines = live->needs + live_words;
+		bb->priv = live;
+		i++;
 	} END_FOR_EACH_PTR(bb);
+
+	/* Add all the bb pseudo usage */
+	for_each_insn(ep, insn_defines, insn_uses);
+
+	/* Calculate liveness.. */
+	for (i = 0; i < nr_live_bbs; i++) {
+		worklist[nr_work++] = i;
+		live_bbs[i].queued = 1;
+	}
+	while (nr_work) {
+		live = &live_bbs[worklist[--nr_work]];
+		live->queued = 0;
+		FOR_EACH_PTR(live->bb->parents, parent) {
+			other = get_live_bb(parent);
+			if (!other)
+				continue;
+			if (merge_live_needs(other, live) && !other->queued) {
+				other->queued = 1;
+				worklist[nr_work++] = other - live_bbs;
+			}
+		} END_FOR_EACH_PTR(parent);
+	}
+
+	/* Remove the pseudos from the "defines" list that are not used by a child */
+	for (i = 0; i < nr_live_bbs; i++) {
+		live = &live_bbs[i];
+		memset(used, 0, live_words * sizeof(*used));
+		FOR_EACH_PTR(live->bb->children, child) {
+			other = get_live_bb(child);
+			if (!other)
+				continue;
+			for (j = 0; j < live_words; j++)
+				used[j] |= other->needs[j];
+		} END_FOR_EACH_PTR(child);
+		for (j = 0; j < live_words; j++)
+			live->defines[j] &= used[j];
+
+		live_set_to_list(live->needs, &live->bb->needs);
+		live_set_to_list(live->defines, &live->bb->defines);
+	}
+
+	for (i = 0; i < nr_live_bbs; i++)
+		live_bbs[i].bb->priv = live_bbs[i].priv;
+	free(worklist);
+	free(live_pseudos);
+	free(sets);
+	free(live_bbs);
+	live_bbs = NULL;
+	nr_live_bbs = 0;
 }
 
 static void merge_pseudo_list(struct pseudo_list *src, struct pseudo_list **dest)
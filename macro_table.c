@@ -35,15 +35,23 @@ static inline int equalkeys(void *_pos1, void *_pos2)
 		pos1->stream == pos2->stream;
 }
 
+/*
+ * The tokens are freed after every file so the table needs its own copy of
+ * the position.
+ */
 void store_macro_pos(struct token *token)
 {
+	struct position *pos;
+
 	if (!macro_table)
 		macro_table = create_hashtable(5000, position_hash, equalkeys);
 
 	if (get_macro_name(token->pos))
 		return;
 
-	do_insert_macro(macro_table, &token->pos, token->ident->name);
+	pos = malloc(sizeof(*pos));
+	*pos = token->pos;
+	do_insert_macro(macro_table, pos, token->ident->name);
 }
 
 char *get_macro_name(struct position pos)
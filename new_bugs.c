@@ -0,0 +1,457 @@
+/*
+ * smatch/new_bugs.c
+ *
+ * Copyright (C) 2013 Oracle.
+ *
+ * Licensed under the Open Software License version 1.1
+ *
+ */
+
+/*
+ * Compare two smatch warning files and print the warnings which are new.
+ *
+ * Line numbers change all the time when code is edited, so a warning is
+ * identified by the file, the function, the type ("warn", "error") and the
+ * message with any "line 123" references blanked out.  The same warning can
+ * show up several times in a function so we count them; if the new run has
+ * it three times and the old run twice then the last one is printed as new.
+ *
+ * Both the text output and the --output=jsonl output are understood and
+ * they make the same keys, so a text baseline can be compared against a
+ * jsonl run.  The JSON records also say where the function starts.  When
+ * every warning in both files has that, the line relative to the start of
+ * the function is part of the key as well.  The text format doesn't have
+ * it so if either file is text we go by the counts alone.
+ *
+ * usage:  new_bugs [--fixed|--all] <new file> <old file>
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+struct warning {
+	const char *line;
+	int line_len;
+	char *key;
+	unsigned int hash;
+	int rel_line;	/* -1 if we don't know where the function starts */
+};
+
+struct bucket {
+	const char *key;
+	unsigned int hash;
+	int count;
+};
+
+struct table {
+	struct bucket *buckets;
+	unsigned int size, used;
+};
+
+struct warn_file {
+	char *data;
+	struct warning *warns;
+	int nr;
+	int have_rel_lines;
+};
+
+static unsigned int hash_str(const char *str)
+{
+	unsigned int hash = 2166136261u;	/* FNV-1a */
+
+	while (*str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+static void *xmalloc(size_t size)
+{
+	void *p = malloc(size);
+
+	if (!p) {
+		fprintf(stderr, "new_bugs: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static struct bucket *lookup(struct table *t, const char *key, unsigned int hash)
+{
+	unsigned int i = hash & (t->size - 1);
+
+	while (t->buckets[i].key) {
+		if (t->buckets[i].hash == hash && !strcmp(t->buckets[i].key, key))
+			break;
+		i = (i + 1) & (t->size - 1);
+	}
+	return &t->buckets[i];
+}
+
+static void init_table(struct table *t, int nr)
+{
+	t->size = 64;
+	while (t->size < nr * 2)
+		t->size *= 2;
+	t->used = 0;
+	t->buckets = xmalloc(t->size * sizeof(*t->buckets));
+	memset(t->buckets, 0, t->size * sizeof(*t->buckets));
+}
+
+static void add_warnings(struct table *t, struct warn_file *file)
+{
+	struct bucket *b;
+	int i;
+
+	init_table(t, file->nr);
+	for (i = 0; i < file->nr; i++) {
+		b = lookup(t, file->warns[i].key, file->warns[i].hash);
+		if (!b->key) {
+			b->key = file->warns[i].key;
+			b->hash = file->warns[i].hash;
+			t->used++;
+		}
+		b->count++;
+	}
+}
+
+/* "... (see line 123)" becomes "... (see line #)" */
+static void append_message(char **p, const char *msg, int len)
+{
+	const char *end = msg + len;
+
+	while (msg < end) {
+		if (end - msg > 5 && !strncmp(msg, "line ", 5) &&
+		    isdigit((unsigned char)msg[5])) {
+			memcpy(*p, "line #", 6);
+			*p += 6;
+			msg += 5;
+			while (msg < end && isdigit((unsigned char)*msg))
+				msg++;
+			continue;
+		}
+		*(*p)++ = *msg++;
+	}
+}
+
+static void append(char **p, const char *str, int len)
+{
+	memcpy(*p, str, len);
+	*p += len;
+}
+
+/*
+ * Every key is "file\tfunction\ttype\tmessage".  The JSON strings have
+ * already been unescaped so they match the text output byte for byte.
+ */
+static char *make_key(const char *file, int file_len, const char *func, int func_len,
+		      const char *type, int type_len, const char *msg, int msg_len)
+{
+	char *key, *p;
+
+	p = key = xmalloc(file_len + func_len + type_len + msg_len + 4);
+	append(&p, file, file_len);
+	*p++ = '\t';
+	append(&p, func, func_len);
+	*p++ = '\t';
+	append(&p, type, type_len);
+	*p++ = '\t';
+	append_message(&p, msg, msg_len);
+	*p = '\0';
+	return key;
+}
+
+/*
+ * Find "name":"value" in one of our own JSON lines and unescape the value
+ * into a new buffer.  smatch only ever uses \uXXXX for control characters.
+ */
+static char *json_field(const char *line, int len, const char *name, int *val_len)
+{
+	char pattern[32];
+	const char *p, *end = line + len;
+	char *val, *v;
+	int plen;
+
+	plen = snprintf(pattern, sizeof(pattern), "\"%s\":\"", name);
+	for (p = line; p + plen <= end; p++) {
+		if (memcmp(p, pattern, plen) != 0)
+			continue;
+		p += plen;
+		v = val = xmalloc(end - p + 1);
+		while (p < end && *p != '"') {
+			if (*p != '\\' || p + 1 == end) {
+				*v++ = *p++;
+				continue;
+			}
+			p++;
+			switch (*p) {
+			case 't':
+				*v++ = '\t';
+				break;
+			case 'n':
+				*v++ = '\n';
+				break;
+			case 'u':
+				if (end - p >= 5 && isxdigit((unsigned char)p[1])) {
+					int c = 0, i;
+
+					for (i = 1; i <= 4; i++)
+						c = c * 16 + (isdigit((unsigned char)p[i]) ?
+							      p[i] - '0' :
+							      tolower((unsigned char)p[i]) - 'a' + 10);
+					*v++ = c;
+					p += 4;
+					break;
+				}
+				/* fall through */
+			default:
+				*v++ = *p;
+			}
+			p++;
+		}
+		*v = '\0';
+		*val_len = v - val;
+		return val;
+	}
+	return NULL;
+}
+
+/* "name":123 */
+static int json_number(const char *line, int len, const char *name)
+{
+	char pattern[32];
+	const char *p, *end = line + len;
+	int plen;
+
+	plen = snprintf(pattern, sizeof(pattern), "\"%s\":", name);
+	for (p = line; p + plen < end; p++) {
+		if (memcmp(p, pattern, plen) == 0 && isdigit((unsigned char)p[plen]))
+			return atoi(p + plen);
+	}
+	return -1;
+}
+
+static char *json_key(const char *line, int len, int *rel_line)
+{
+	char *file, *func, *type, *msg;
+	int file_len, func_len = 0, type_len, msg_len;
+	int line_nr, func_line;
+	char *key = NULL;
+
+	type = json_field(line, len, "type", &type_len);
+	if (!type)
+		return NULL;
+	if (strcmp(type, "warn") != 0 && strcmp(type, "error") != 0) {
+		free(type);
+		return NULL;
+	}
+	file = json_field(line, len, "file", &file_len);
+	msg = json_field(line, len, "message", &msg_len);
+	func = json_field(line, len, "function", &func_len);
+	if (file && msg)
+		key = make_key(file, file_len, func ? func : "", func ? func_len : 0,
+			       type, type_len, msg, msg_len);
+
+	line_nr = json_number(line, len, "line");
+	func_line = json_number(line, len, "function_line");
+	*rel_line = -1;
+	if (func && line_nr >= 0 && func_line > 0 && line_nr >= func_line)
+		*rel_line = line_nr - func_line;
+
+	free(type);
+	free(file);
+	free(msg);
+	free(func);
+	return key;
+}
+
+static int at(const char *p, const char *end, const char *str)
+{
+	int len = strlen(str);
+
+	return end - p >= len && !memcmp(p, str, len);
+}
+
+/*
+ * Smatch:  "file.c:123 func() warn: message"
+ * Sparse:  "file.c:123:4: warning: message"
+ */
+static char *text_key(const char *line, int len)
+{
+	static const char *types[] = { "warn", "error", "warning" };
+	const char *end = line + len;
+	const char *file_end, *func = "", *type = NULL, *msg = NULL, *p;
+	int func_len = 0, type_len = 0;
+	int i;
+
+	for (p = line; p < end && !type; p++) {
+		if (*p != ' ')
+			continue;
+		for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+			type_len = strlen(types[i]);
+			if (at(p + 1, end, types[i]) && at(p + 1 + type_len, end, ":")) {
+				type = p + 1;
+				break;
+			}
+		}
+	}
+	if (!type)
+		return NULL;
+	msg = type + type_len + 1;
+	if (msg < end && *msg == ' ')
+		msg++;
+
+	file_end = memchr(line, ':', type - line);
+	if (!file_end)
+		return NULL;
+
+	/* the function is the word before the type if it ends in "()" */
+	if (type - line >= 3 && type[-2] == ')' && type[-3] == '(') {
+		p = type - 3;
+		while (p > file_end && p[-1] != ' ')
+			p--;
+		func = p;
+		func_len = type - 3 - p;
+	}
+
+	return make_key(line, file_end - line, func, func_len, type, type_len,
+			msg, end - msg);
+}
+
+static void read_warnings(const char *filename, struct warn_file *file)
+{
+	FILE *f;
+	long size;
+	char *line, *end, *nl;
+	int alloc = 1024;
+	int len, rel_line;
+	char *key;
+
+	f = fopen(filename, "r");
+	if (!f) {
+		perror(filename);
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	file->data = xmalloc(size + 1);
+	if (fread(file->data, 1, size, f) != size) {
+		perror(filename);
+		exit(1);
+	}
+	fclose(f);
+	file->data[size] = '\0';
+
+	file->nr = 0;
+	file->have_rel_lines = 1;
+	file->warns = xmalloc(alloc * sizeof(*file->warns));
+	end = file->data + size;
+	for (line = file->data; line < end; line = nl + 1) {
+		nl = memchr(line, '\n', end - line);
+		if (!nl)
+			nl = end;
+		len = nl - line;
+		rel_line = -1;
+		if (len && line[0] == '{')
+			key = json_key(line, len, &rel_line);
+		else
+			key = text_key(line, len);
+		if (!key)
+			continue;
+		if (file->nr == alloc) {
+			alloc *= 2;
+			file->warns = realloc(file->warns, alloc * sizeof(*file->warns));
+			if (!file->warns) {
+				fprintf(stderr, "new_bugs: out of memory\n");
+				exit(1);
+			}
+		}
+		file->warns[file->nr].line = line;
+		file->warns[file->nr].line_len = len;
+		file->warns[file->nr].key = key;
+		file->warns[file->nr].rel_line = rel_line;
+		if (rel_line < 0)
+			file->have_rel_lines = 0;
+		file->nr++;
+	}
+}
+
+static void finish_keys(struct warn_file *file, int use_rel_lines)
+{
+	struct warning *warn;
+	char *key;
+	int i;
+
+	for (i = 0; i < file->nr; i++) {
+		warn = &file->warns[i];
+		if (use_rel_lines) {
+			key = xmalloc(strlen(warn->key) + 16);
+			sprintf(key, "%s\t%d", warn->key, warn->rel_line);
+			free(warn->key);
+			warn->key = key;
+		}
+		warn->hash = hash_str(warn->key);
+	}
+}
+
+/* print the warnings in "file" which aren't in "other" */
+static void print_missing(struct warn_file *file, struct warn_file *other, const char *prefix)
+{
+	struct table t;
+	struct bucket *b;
+	int i;
+
+	add_warnings(&t, other);
+	for (i = 0; i < file->nr; i++) {
+		b = lookup(&t, file->warns[i].key, file->warns[i].hash);
+		if (b->key && b->count > 0) {
+			b->count--;
+			continue;
+		}
+		printf("%s%.*s\n", prefix, file->warns[i].line_len, file->warns[i].line);
+	}
+	free(t.buckets);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage:  %s [--fixed|--all] <new file> <old file>\n", prog);
+	fprintf(stderr, "  --fixed  print the warnings which went away instead\n");
+	fprintf(stderr, "  --all    print both, prefixed with '+' and '-'\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct warn_file new, old;
+	int show_new = 1, show_fixed = 0;
+	int use_rel_lines;
+	int i = 1;
+
+	if (argc > 1 && !strcmp(argv[1], "--fixed")) {
+		show_new = 0;
+		show_fixed = 1;
+		i++;
+	} else if (argc > 1 && !strcmp(argv[1], "--all")) {
+		show_fixed = 1;
+		i++;
+	}
+	if (argc - i != 2)
+		usage(argv[0]);
+
+	read_warnings(argv[i], &new);
+	read_warnings(argv[i + 1], &old);
+	use_rel_lines = new.have_rel_lines && old.have_rel_lines;
+	finish_keys(&new, use_rel_lines);
+	finish_keys(&old, use_rel_lines);
+
+	if (show_new)
+		print_missing(&new, &old, show_fixed ? "+" : "");
+	if (show_fixed)
+		print_missing(&old, &new, show_new ? "-" : "");
+	return 0;
+}
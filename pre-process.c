@@ -19,6 +19,8 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <time.h>
+#include <dirent.h>
+#include <errno.h>
 
 #include "lib.h"
 #include "allocate.h"
@@ -29,6 +31,7 @@
 #include "scope.h"
 
 static int false_nesting = 0;
+int include_cache = 1;
 
 #define INCLUDEPATHS 300
 const char *includepath[INCLUDEPATHS+1] = {
@@ -738,15 +741,16 @@ static const char *token_name_sequence(struct token *token, int endop, struct to
 
 static int already_tokenized(const char *path)
 {
+	unsigned int hash = hash_stream(path);
 	int stream, next;
 
-	for (stream = *hash_stream(path); stream >= 0 ; stream = next) {
+	for (stream = first_hashed_stream(hash); stream >= 0 ; stream = next) {
 		struct stream *s = input_streams + stream;
 
 		next = s->next_stream;
 		if (s->constant != CONSTANT_FILE_YES)
 			continue;
-		if (strcmp(path, s->name))
+		if (s->hash != hash || strcmp(path, s->name))
 			continue;
 		if (s->protect && !lookup_macro(s->protect))
 			continue;
@@ -815,6 +819,132 @@ static void set_stream_include_path(struct stream *stream)
 	includepath[0] = path;
 }
 
+/*
+ * Most include probes fail, every header is looked for in each of the -I
+ * directories in turn.  Instead of an open() for every one of those each
+ * directory is read once and the name is looked up in its listing so the
+ * only open() left is the one which finds the file.  -fno-include-cache
+ * turns it off.
+ */
+struct include_dir {
+	struct include_dir *next;
+	char *path;
+	unsigned int hash;
+	int unlisted;		/* couldn't read it, probe with open() */
+	int nr, size;
+	struct include_name {
+		unsigned int hash;
+		char *name;
+	} *names;
+};
+
+#define INCLUDE_DIR_HASH_BITS (8)
+static struct include_dir *include_dirs[1 << INCLUDE_DIR_HASH_BITS];
+
+static void add_include_name(struct include_dir *dir, const char *name)
+{
+	unsigned int hash = hash_stream(name);
+	int i;
+
+	if (dir->nr * 2 >= dir->size) {
+		struct include_name *old = dir->names;
+		int old_size = dir->size;
+
+		dir->size = dir->size ? dir->size * 2 : 64;
+		dir->names = calloc(dir->size, sizeof(*dir->names));
+		if (!dir->names)
+			die("out of memory for the include cache");
+		dir->nr = 0;
+		for (i = 0; i < old_size; i++) {
+			if (old[i].name)
+				add_include_name(dir, old[i].name);
+		}
+		free(old);
+	}
+	for (i = hash & (dir->size - 1); dir->names[i].name; i = (i + 1) & (dir->size - 1))
+		;
+	dir->names[i].hash = hash;
+	dir->names[i].name = (char *)name;
+	dir->nr++;
+}
+
+static struct include_dir *read_include_dir(const char *path, unsigned int hash)
+{
+	struct include_dir *dir;
+	struct dirent *de;
+	DIR *d;
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir)
+		die("out of memory for the include cache");
+	dir->path = strdup(path);
+	dir->hash = hash;
+
+	d = opendir(path);
+	if (!d) {
+		/* a missing directory has nothing in it, anything else we can't tell */
+		dir->unlisted = errno != ENOENT && errno != ENOTDIR;
+		return dir;
+	}
+	while ((de = readdir(d)) != NULL)
+		add_include_name(dir, strdup(de->d_name));
+	closedir(d);
+	return dir;
+}
+
+static struct include_dir *get_include_dir(const char *path)
+{
+	unsigned int hash = hash_stream(path);
+	struct include_dir **head, *dir;
+
+	head = &include_dirs[hash & ((1 << INCLUDE_DIR_HASH_BITS) - 1)];
+	for (dir = *head; dir; dir = dir->next) {
+		if (dir->hash == hash && !strcmp(dir->path, path))
+			return dir;
+	}
+	dir = read_include_dir(path, hash);
+	dir->next = *head;
+	*head = dir;
+	return dir;
+}
+
+/* Returns 0 if there is certainly no such file so we don't have to open() it. */
+static int include_may_exist(char *fullname)
+{
+	struct include_dir *dir;
+	char *slash, *name;
+	unsigned int hash;
+	int i;
+
+	if (!include_cache)
+		return 1;
+
+	slash = strrchr(fullname, '/');
+	if (!slash) {
+		dir = get_include_dir(".");
+		name = fullname;
+	} else if (slash == fullname) {
+		dir = get_include_dir("/");
+		name = slash + 1;
+	} else {
+		*slash = '\0';
+		dir = get_include_dir(fullname);
+		*slash = '/';
+		name = slash + 1;
+	}
+	if (dir->unlisted)
+		return 1;
+	if (!dir->nr)
+		return 0;
+
+	hash = hash_stream(name);
+	for (i = hash & (dir->size - 1); dir->names[i].name; i = (i + 1) & (dir->size - 1)) {
+		if (dir->names[i].hash == hash && !strcmp(dir->names[i].name, name))
+			return 1;
+	}
+	return 0;
+}
+
 static int try_include(const char *path, const char *filename, int flen, struct token **where, const char **next_path)
 {
 	int fd;
@@ -829,6 +959,8 @@ static int try_include(const char *path, const char *filename, int flen, struct
 	memcpy(fullname+plen, filename, flen);
 	if (already_tokenized(fullname))
 		return 1;
+	if (!include_may_exist(fullname))
+		return 0;
 	fd = open(fullname, O_RDONLY);
 	if (fd >= 0) {
 		char * streamname = __alloc_bytes(plen + flen);
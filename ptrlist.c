@@ -15,6 +15,34 @@
 
 __DECLARE_ALLOCATOR(struct ptr_list, ptrlist);
 __ALLOCATOR(struct ptr_list, "ptr list", ptrlist);
+__DECLARE_ALLOCATOR(struct ptr_list, arena_ptrlist);
+__ALLOCATOR(struct ptr_list, "arena ptr list", arena_ptrlist);
+
+/* every node of a list comes from the same allocator as the first one */
+static struct ptr_list *alloc_list_node(int arena)
+{
+	struct ptr_list *list;
+
+	if (arena)
+		list = __alloc_arena_ptrlist(0);
+	else
+		list = __alloc_ptrlist(0);
+	list->arena = arena;
+	return list;
+}
+
+static void free_list_node(struct ptr_list *list)
+{
+	if (list->arena)
+		__free_arena_ptrlist(list);
+	else
+		__free_ptrlist(list);
+}
+
+void free_ptr_list_arena(void)
+{
+	clear_arena_ptrlist_alloc();
+}
 
 int ptr_list_size(struct ptr_list *head)
 {
@@ -77,14 +105,14 @@ restart:
 			if (!entry->nr) {
 				struct ptr_list *prev;
 				if (next == entry) {
-					__free_ptrlist(entry);
+					free_list_node(entry);
 					*listp = NULL;
 					return;
 				}
 				prev = entry->prev;
 				prev->next = next;
 				next->prev = prev;
-				__free_ptrlist(entry);
+				free_list_node(entry);
 				if (entry == head) {
 					*listp = next;
 					head = next;
@@ -100,7 +128,7 @@ restart:
 void split_ptr_list_head(struct ptr_list *head)
 {
 	int old = head->nr, nr = old / 2;
-	struct ptr_list *newlist = __alloc_ptrlist(0);
+	struct ptr_list *newlist = alloc_list_node(head->arena);
 	struct ptr_list *next = head->next;
 
 	old -= nr;
@@ -114,7 +142,7 @@ void split_ptr_list_head(struct ptr_list *head)
 	memset(head->list + old, 0xf0, nr * sizeof(void *));
 }
 
-void **__add_ptr_list(struct ptr_list **listp, void *ptr, unsigned long tag)
+static void **add_ptr_list_helper(struct ptr_list **listp, void *ptr, unsigned long tag, int arena)
 {
 	struct ptr_list *list = *listp;
 	struct ptr_list *last = NULL; /* gcc complains needlessly */
@@ -127,7 +155,7 @@ void **__add_ptr_list(struct ptr_list **listp, void *ptr, unsigned long tag)
 	ptr = (void *)(tag | (unsigned long)ptr);
 
 	if (!list || (nr = (last = list->prev)->nr) >= LIST_NODE_NR) {
-		struct ptr_list *newlist = __alloc_ptrlist(0);
+		struct ptr_list *newlist = alloc_list_node(list ? list->arena : arena);
 		if (!list) {
 			newlist->next = newlist;
 			newlist->prev = newlist;
@@ -148,6 +176,16 @@ void **__add_ptr_list(struct ptr_list **listp, void *ptr, unsigned long tag)
 	return ret;
 }
 
+void **__add_ptr_list(struct ptr_list **listp, void *ptr, unsigned long tag)
+{
+	return add_ptr_list_helper(listp, ptr, tag, 0);
+}
+
+void **__add_ptr_list_arena(struct ptr_list **listp, void *ptr, unsigned long tag)
+{
+	return add_ptr_list_helper(listp, ptr, tag, 1);
+}
+
 int delete_ptr_list_entry(struct ptr_list **list, void *entry, int count)
 {
 	void *ptr;
@@ -217,7 +255,7 @@ void * delete_ptr_list_last(struct ptr_list **head)
 		last->prev->next = first;
 		if (last == first)
 			*head = NULL;
-		__free_ptrlist(last);
+		free_list_node(last);
 	}
 	return ptr;
 }
@@ -241,7 +279,7 @@ void __free_ptr_list(struct ptr_list **listp)
 	while (list) {
 		tmp = list;
 		list = list->next;
-		__free_ptrlist(tmp);
+		free_list_node(tmp);
 	}
 
 	*listp = NULL;
@@ -26,6 +26,7 @@
 
 struct ptr_list {
 	int nr;
+	int arena;
 	struct ptr_list *prev;
 	struct ptr_list *next;
 	void *list[LIST_NODE_NR];
@@ -40,6 +41,8 @@ int replace_ptr_list_entry(struct ptr_list **, void *old, void *new, int);
 extern void sort_list(struct ptr_list **, int (*)(const void *, const void *));
 
 extern void **__add_ptr_list(struct ptr_list **, void *, unsigned long);
+extern void **__add_ptr_list_arena(struct ptr_list **, void *, unsigned long);
+extern void free_ptr_list_arena(void);
 extern void concat_ptr_list(struct ptr_list *a, struct ptr_list **b);
 extern void __free_ptr_list(struct ptr_list **);
 extern int ptr_list_size(struct ptr_list *);
@@ -59,6 +62,14 @@ extern int linearize_ptr_list(struct ptr_list *, void **, int);
 								    (unsigned long)(entry) & 3)))
 #define add_ptr_list(list,entry) \
 	add_ptr_list_tag(list,entry,0)
+/*
+ * A list started with add_ptr_list_arena() gets all of its nodes from the
+ * arena, even the ones added later with add_ptr_list().  The arena is
+ * thrown away in one go by free_ptr_list_arena() so don't keep those lists
+ * around after that.
+ */
+#define add_ptr_list_arena(list,entry) \
+	MKTYPE(*(list), (CHECK_TYPE(*(list),(entry)),__add_ptr_list_arena((struct ptr_list **)(list), (entry), 0)))
 #define free_ptr_list(list) \
 	do { VRFY_PTR_LIST(*(list)); __free_ptr_list((struct ptr_list **)(list)); } while (0)
 
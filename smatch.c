@@ -28,7 +28,9 @@ int option_no_db = 0;
 int option_debug_related;
 int option_file_output;
 int option_time;
+int option_stats;
 char *option_datadir_str;
+char *option_server_str;
 FILE *sm_outfd;
 
 typedef void (*reg_func) (int id);
@@ -44,7 +46,7 @@ int num_checks = ARRAY_SIZE(reg_funcs);
 
 const char *check_name(unsigned short id)
 {
-	if (id > ARRAY_SIZE(reg_funcs))
+	if (id == 0 || id > ARRAY_SIZE(reg_funcs))
 		return "internal";
 
 	return reg_funcs[id - 1].name;
@@ -76,8 +78,15 @@ static void help(void)
 	printf("--no-implied:  ignore implications.\n");
 	printf("--assume-loops:  assume loops always go through at least once.\n");
 	printf("--known-conditions:  don't branch for known conditions.\n");
-	printf("--two-passes:  use a two pass system for each function.\n");
+	printf("--two-passes:  parse loops and code reached by backward gotos twice.\n");
 	printf("--file-output:  instead of printing stdout, print to \"file.c.smatch_out\".\n");
+	printf("--stats:  print time, memory and sm_state counts to stderr at the end.\n");
+	printf("--mem-stats[=N]:  print allocator usage per file and the N hungriest functions.\n");
+	printf("--jobs=<n>:  split the functions in each file between n processes.\n");
+	printf("--snapshot:  parse the -include headers once and check each file in a copy.\n");
+	printf("--output=jsonl:  print one JSON object per message.\n");
+	printf("--server=<socket>:  load everything once and check files sent by --client.\n");
+	printf("--client=<socket>:  have the server listening on <socket> check the files.\n");
 	printf("--help:  print this helpful message.\n");
 	exit(1);
 }
@@ -137,6 +146,45 @@ void parse_args(int *argcp, char ***argvp)
 			(*argvp)[1] = (*argvp)[0];
 			found = 1;
 		}
+		if (!found && !strncmp((*argvp)[1], "--output=", 9)) {
+			if (!strcmp((*argvp)[1] + 9, "jsonl"))
+				option_output_jsonl = 1;
+			else if (!strcmp((*argvp)[1] + 9, "text"))
+				option_output_jsonl = 0;
+			else {
+				printf("Unknown output format: %s\n", (*argvp)[1] + 9);
+				exit(1);
+			}
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strcmp((*argvp)[1], "--mem-stats")) {
+			option_mem_stats = 10;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--mem-stats=", 12)) {
+			option_mem_stats = atoi((*argvp)[1] + 12);
+			if (option_mem_stats <= 0)
+				option_mem_stats = 10;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--jobs=", 7)) {
+			option_jobs = atoi((*argvp)[1] + 7);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--server=", 9)) {
+			option_server_str = (*argvp)[1] + 9;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--client=", 9)) {
+			/* handled in main(), this is the server seeing it */
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
 
 		OPTION(spammy);
 		OPTION(info);
@@ -153,6 +201,8 @@ void parse_args(int *argcp, char ***argvp)
 		OPTION(call_tree);
 		OPTION(file_output);
 		OPTION(time);
+		OPTION(stats);
+		OPTION(snapshot);
 		if (!found)
 			break;
 		(*argcp)--;
@@ -209,8 +259,15 @@ int main(int argc, char **argv)
 	int i;
 	reg_func func;
 
+	/* the server parses the whole command line so send it untouched */
+	for (i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--client=", 9))
+			return smatch_client(argv[i] + 9, argc - 1, argv + 1);
+	}
+
 	sm_outfd = stdout;
 	parse_args(&argc, &argv);
+	sm_output_init(sm_outfd);
 
 	/* this gets set back to zero when we parse the first function */
 	final_pass = 1;
@@ -223,8 +280,15 @@ int main(int argc, char **argv)
 		func = reg_funcs[i].func;
 		/* The script IDs start at 1.
 		   0 is used for internal stuff. */
+		__cur_check = i + 1;
 		func(i + 1);
 	}
+	__cur_check = 0;
+
+	if (option_server_str) {
+		smatch_server(option_server_str);
+		return 0;
+	}
 
 	smatch(argc, argv);
 	free_string(data_dir);
@@ -48,21 +48,46 @@ static inline int PTR_INT(void *p)
 	return (int)(long)p;
 }
 
+/*
+ * Most sm_states are never merged so the merge history lives in a separate
+ * struct sm_merge which is only allocated for merged states.  Use
+ * sm_left(), sm_right() and sm_nr_children() to get at it.
+ */
+struct sm_merge {
+	struct sm_state *left;
+	struct sm_state *right;
+	unsigned int nr_children;
+};
+
 struct sm_state {
 	unsigned short owner;
 	unsigned short merged:1;
 	unsigned short implied:1;
-	unsigned int nr_children;
+	unsigned short summary:1;
 	unsigned int line;
 	const char *name;
 	struct symbol *sym;
   	struct smatch_state *state;
 	struct state_list *pool;
-	struct sm_state *left;
-	struct sm_state *right;
+	struct sm_merge *merge;
 	struct state_list *possible;
 };
 
+static inline struct sm_state *sm_left(struct sm_state *sm)
+{
+	return sm->merge ? sm->merge->left : NULL;
+}
+
+static inline struct sm_state *sm_right(struct sm_state *sm)
+{
+	return sm->merge ? sm->merge->right : NULL;
+}
+
+static inline unsigned int sm_nr_children(struct sm_state *sm)
+{
+	return sm->merge ? sm->merge->nr_children : 1;
+}
+
 struct var_sym {
 	char *var;
 	struct symbol *sym;
@@ -124,6 +149,9 @@ typedef struct smatch_state *(merge_func_t)(struct smatch_state *s1, struct smat
 typedef struct smatch_state *(unmatched_func_t)(struct sm_state *state);
 void add_merge_hook(int client_id, merge_func_t *func);
 void add_unmatched_state_hook(int client_id, unmatched_func_t *func);
+void add_summarize_hook(int client_id, merge_func_t *func);
+void preserve_unmerged_possibles(int client_id);
+void run_in_loop_prepass(int client_id);
 typedef void (scope_hook)(void *data);
 void add_scope_hook(scope_hook *hook, void *data);
 typedef void (func_hook)(const char *fn, struct expression *expr, void *data);
@@ -167,10 +195,27 @@ extern int option_info;
 int is_silenced_function(void);
 
 extern FILE *sm_outfd;
-#define sm_printf(msg...) do { if (final_pass || option_debug) fprintf(sm_outfd, msg); } while (0)
+extern int option_output_jsonl;
+extern int __cur_check;
+void sm_output_init(FILE *fd);
+void sm_json_prefix(void);
+void sm_json_printf(const char *fmt, ...) FORMAT_ATTR(1);
+
+#define sm_printf(msg...) do {					\
+	if (final_pass || option_debug) {			\
+		if (option_output_jsonl)			\
+			sm_json_printf(msg);			\
+		else						\
+			fprintf(sm_outfd, msg);			\
+	}							\
+} while (0)
 
 static inline void sm_prefix(void)
 {
+	if (option_output_jsonl) {
+		sm_json_prefix();
+		return;
+	}
 	sm_printf("%s:%d %s() ", get_filename(), get_lineno(), get_function());
 }
 
@@ -319,6 +364,8 @@ struct symbol *get_member_type_from_key(struct expression *expr, char *key);
 /* smatch_ignore.c */
 void add_ignore(int owner, const char *name, struct symbol *sym);
 int is_ignored(int owner, const char *name, struct symbol *sym);
+int __get_nr_ignores(void);
+void __drop_ignores(int nr);
 
 /* smatch_var_sym */
 struct var_sym *alloc_var_sym(const char *var, struct symbol *sym);
@@ -364,6 +411,7 @@ extern int option_two_passes;
 extern int option_no_db;
 extern int option_file_output;
 extern int option_time;
+extern int option_stats;
 extern struct expression_list *big_expression_stack;
 extern struct statement_list *big_statement_stack;
 int inlinable(struct expression *expr);
@@ -371,6 +419,7 @@ extern int __inline_call;
 extern struct expression *__inline_fn;
 extern int __in_pre_condition;
 extern int __bail_on_rest_of_function;
+extern int __in_prepass;
 
 /* smatch_project.c */
 int is_no_inline_function(const char *function);
@@ -394,6 +443,10 @@ struct state_list *__implied_case_slist(struct expression *switch_expr,
 					struct state_list **raw_slist);
 struct range_list *__get_implied_values(struct expression *switch_expr);
 void overwrite_states_using_pool(struct sm_state *sm);
+struct state_list_stack;
+void __separate_pools(struct sm_state *sm, int comparison, struct range_list *vals,
+		      struct state_list_stack **true_stack,
+		      struct state_list_stack **false_stack);
 
 /* smatch_extras.c */
 #define SMATCH_EXTRA 1 /* this is my_id from smatch extra set in smatch.c */
@@ -448,6 +501,9 @@ void save_all_states(void);
 void nullify_all_states(void);
 void restore_all_states(void);
 void clear_all_states(void);
+void __start_prepass(struct state_list *head);
+struct state_list *__end_prepass(const void *goto_key);
+void __merge_back_edge(struct state_list *slist);
 
 struct sm_state *get_sm_state(int owner, const char *name,
 				struct symbol *sym);
@@ -497,12 +553,14 @@ int __pop_default(void);
 void __push_conditions(void);
 void __discard_conditions(void);
 
-void __save_gotos(const char *name);
-void __merge_gotos(const char *name);
+void __save_gotos(const void *key);
+void __merge_gotos(const void *key);
 
 void __print_cur_slist(void);
 
 /* smatch_hooks.c */
+extern int __core_hooks_only;
+int __hook_enabled(int owner);
 void __pass_to_client(void *data, enum hook_type type);
 void __pass_to_client_no_data(enum hook_type type);
 void __pass_case_to_client(struct expression *switch_expr,
@@ -602,6 +660,8 @@ void sql_exec(int (*callback)(void*, int, char**, char**), const char *sql);
 void sql_mem_exec(int (*callback)(void*, int, char**, char**), const char *sql);
 
 void open_smatch_db(void);
+void close_smatch_db(void);
+void reopen_smatch_db(void);
 
 /* smatch_files.c */
 int open_data_file(const char *filename);
@@ -625,6 +685,31 @@ enum project_type {
 };
 extern enum project_type option_project;
 const char *check_name(unsigned short id);
+void parse_args(int *argcp, char ***argvp);
+
+/* smatch_server.c */
+int smatch_client(const char *path, int argc, char **argv);
+void smatch_server(const char *path);
+
+/* smatch_mem_stats.c */
+extern int option_mem_stats;
+void mem_stats_function_start(void);
+void mem_stats_function_end(const char *name);
+void mem_stats_file_end(const char *file);
+
+/* smatch_jobs.c */
+extern int option_jobs;
+int jobs_fork(int nr_functions, void *stats, int stats_size,
+	      void (*merge_stats)(void *stats));
+int job_owns_unit(int unit);
+void job_start_unit(int unit);
+void job_start_inline(const void *key);
+void job_end_record(void);
+void jobs_finish(const void *stats, int stats_size);
+extern int option_snapshot;
+int snapshot_fork(int nr_files, void *stats, int stats_size,
+		  void (*merge_stats)(void *stats));
+void snapshot_finish(const void *stats, int stats_size);
 
 
 /* smatch_buf_size.c */
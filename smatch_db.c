@@ -24,6 +24,8 @@ static int return_id;
 do {										\
 	if (!mem_db)								\
 		break;								\
+	if (__in_prepass)  /* the real pass inserts it */			\
+		break;								\
 	if (__inline_fn) {							\
 		char buf[1024];							\
 		char *err, *p = buf;						\
@@ -857,7 +859,7 @@ static int call_return_state_hooks_split_possible(struct expression *expr)
 	if (!sm || !sm->merged)
 		return 0;
 
-	if (too_many_possible(sm))
+	if (too_many_possible(sm) || possible_is_summarized(sm))
 		return 0;
 
 	/* bail if it gets too complicated */
@@ -1074,21 +1076,42 @@ static void init_memdb(void)
 	}
 }
 
-void open_smatch_db(void)
+static void open_disk_db(void)
 {
 	int rc;
 
+	rc = sqlite3_open_v2("smatch_db.sqlite", &db, SQLITE_OPEN_READONLY, NULL);
+	if (rc != SQLITE_OK)
+		option_no_db = 1;
+}
+
+void open_smatch_db(void)
+{
 	if (option_no_db)
 		return;
 
 	init_memdb();
+	open_disk_db();
+}
 
-	rc = sqlite3_open_v2("smatch_db.sqlite", &db, SQLITE_OPEN_READONLY, NULL);
-	if (rc != SQLITE_OK) {
-		option_no_db = 1;
+/*
+ * A SQLite handle can't be used on both sides of a fork().  The server
+ * closes the DB before it starts forking and every child opens its own.
+ * The in-memory DB isn't backed by a file so the children just get a copy.
+ */
+void close_smatch_db(void)
+{
+	if (!db)
 		return;
-	}
-	return;
+	sqlite3_close(db);
+	db = NULL;
+}
+
+void reopen_smatch_db(void)
+{
+	if (option_no_db || db)
+		return;
+	open_disk_db();
 }
 
 static void register_common_funcs(void)
@@ -43,6 +43,29 @@ struct smatch_state *merge_estates(struct smatch_state *s1, struct smatch_state
 	return tmp;
 }
 
+/*
+ * This is for when a possible list gets too long.  Instead of keeping every
+ * range we only keep the smallest min and the biggest max.
+ */
+struct smatch_state *summarize_estates(struct smatch_state *s1, struct smatch_state *s2)
+{
+	struct range_list *one = estate_rl(s1);
+	struct range_list *two = estate_rl(s2);
+	sval_t min, max;
+
+	if (!one || !two)
+		return merge_estates(s1, s2);
+
+	min = rl_min(one);
+	if (sval_cmp(rl_min(two), min) < 0)
+		min = rl_min(two);
+	max = rl_max(one);
+	if (sval_cmp(rl_max(two), max) > 0)
+		max = rl_max(two);
+
+	return alloc_estate_range(min, max);
+}
+
 struct data_info *get_dinfo(struct smatch_state *state)
 {
 	if (!state)
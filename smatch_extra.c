@@ -415,6 +415,114 @@ void __extra_pre_loop_hook_after(struct sm_state *sm,
 	set_extra_mod(sm->name, sm->sym, state);
 }
 
+/*
+ * "old" is the value at the top of the loop and "new" is what came back
+ * around.  If "new" doesn't fit then the first time we take the union.
+ * After that we assume it will keep growing and go straight to the min or
+ * max of the type.
+ */
+static struct smatch_state *widen_estate(struct smatch_state *old, struct smatch_state *new, int widen)
+{
+	struct range_list *old_rl = estate_rl(old);
+	struct range_list *new_rl = estate_rl(new);
+	struct range_list *rl;
+	struct symbol *type;
+	sval_t min, max;
+
+	if (!old_rl || !new_rl)
+		return NULL;
+	rl = rl_union(old_rl, new_rl);
+	if (rl_equiv(rl, old_rl))
+		return NULL;
+	if (!widen)
+		return alloc_estate_rl(rl);
+
+	type = rl_type(old_rl);
+	min = rl_min(old_rl);
+	max = rl_max(old_rl);
+	if (sval_cmp(rl_min(new_rl), min) < 0)
+		min = sval_type_min(type);
+	if (sval_cmp(rl_max(new_rl), max) > 0)
+		max = sval_type_max(type);
+	return alloc_estate_range(min, max);
+}
+
+static int is_iterator(struct sm_state *sm, struct sm_state *iterator)
+{
+	if (!iterator)
+		return 0;
+	return sm->sym == iterator->sym && strcmp(sm->name, iterator->name) == 0;
+}
+
+/*
+ * Compare the loop head with the states at the end of the loop body and
+ * make the head big enough to hold both.  The changes are recorded in
+ * "widened" as well.  The canonical loop iterator is left alone because
+ * __extra_handle_canonical_loops() already deals with it.  Returns 1 if
+ * anything changed.
+ */
+int __extra_widen_loop(struct state_list **head, struct state_list **widened,
+		       struct state_list *back, struct sm_state *iterator, int widen)
+{
+	struct state_list *changes = NULL;
+	struct smatch_state *state;
+	struct sm_state *one, *two, *sm;
+	int cmp;
+
+	PREPARE_PTR_LIST(*head, one);
+	PREPARE_PTR_LIST(back, two);
+	for (;;) {
+		if (!one || !two)
+			break;
+		cmp = cmp_tracker(one, two);
+		if (cmp < 0) {
+			NEXT_PTR_LIST(one);
+			continue;
+		}
+		if (cmp > 0) {
+			NEXT_PTR_LIST(two);
+			continue;
+		}
+		if (one->owner == my_id && one->state != two->state &&
+		    !is_iterator(one, iterator)) {
+			state = widen_estate(one->state, two->state, widen);
+			if (state)
+				set_state_slist(&changes, my_id, one->name, one->sym, state);
+		}
+		NEXT_PTR_LIST(one);
+		NEXT_PTR_LIST(two);
+	}
+	FINISH_PTR_LIST(two);
+	FINISH_PTR_LIST(one);
+
+	if (!changes)
+		return 0;
+	FOR_EACH_PTR(changes, sm) {
+		set_state_slist(head, sm->owner, sm->name, sm->sym, sm->state);
+		set_state_slist(widened, sm->owner, sm->name, sm->sym, sm->state);
+	} END_FOR_EACH_PTR(sm);
+	free_slist(&changes);
+	return 1;
+}
+
+/*
+ * The path which comes back around to the top of the loop:  the current
+ * states with the smatch extra states from the end of the pre-pass on top.
+ * The canonical loop iterator is left alone.
+ */
+struct state_list *__extra_back_edge(struct state_list *back, struct sm_state *iterator)
+{
+	struct state_list *ret;
+	struct sm_state *sm;
+
+	ret = clone_slist(__get_cur_slist());
+	FOR_EACH_PTR(back, sm) {
+		if (sm->owner == my_id && !is_iterator(sm, iterator))
+			overwrite_sm_state(&ret, sm);
+	} END_FOR_EACH_PTR(sm);
+	return ret;
+}
+
 static struct state_list *unmatched_slist;
 static struct smatch_state *unmatched_state(struct sm_state *sm)
 {
@@ -1557,6 +1665,9 @@ void register_smatch_extra(int id)
 	my_id = id;
 
 	add_merge_hook(my_id, &merge_estates);
+	add_summarize_hook(my_id, &summarize_estates);
+	preserve_unmerged_possibles(my_id);
+	run_in_loop_prepass(my_id);
 	add_unmatched_state_hook(my_id, &unmatched_state);
 	add_hook(&match_function_def, FUNC_DEF_HOOK);
 	add_hook(&match_declarations, DECLARATION_HOOK);
@@ -1572,6 +1683,7 @@ void register_smatch_extra(int id)
 
 void register_smatch_extra_late(int id)
 {
+	run_in_loop_prepass(id);
 	add_hook(&match_dereferences, DEREF_HOOK);
 	add_hook(&match_pointer_as_array, OP_HOOK);
 	select_call_implies_hook(DEREFERENCE, &set_param_dereferenced);
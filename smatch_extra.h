@@ -97,6 +97,7 @@ struct smatch_state *alloc_estate_whole(struct symbol *type);
 struct smatch_state *clone_estate(struct smatch_state *state);
 
 struct smatch_state *merge_estates(struct smatch_state *s1, struct smatch_state *s2);
+struct smatch_state *summarize_estates(struct smatch_state *s1, struct smatch_state *s2);
 
 int estates_equiv(struct smatch_state *one, struct smatch_state *two);
 int estate_is_whole(struct smatch_state *state);
@@ -141,6 +142,9 @@ int __iterator_unchanged(struct sm_state *sm);
 void __extra_pre_loop_hook_after(struct sm_state *sm,
 				struct statement *iterator,
 				struct expression *condition);
+int __extra_widen_loop(struct state_list **head, struct state_list **widened,
+		       struct state_list *back, struct sm_state *iterator, int widen);
+struct state_list *__extra_back_edge(struct state_list *back, struct sm_state *iterator);
 
 /* smatch_equiv.c */
 void set_equiv(struct expression *left, struct expression *right);
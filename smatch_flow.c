@@ -10,6 +10,8 @@
 #define _GNU_SOURCE 1
 #include <unistd.h>
 #include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include "token.h"
 #include "scope.h"
 #include "smatch.h"
@@ -38,6 +40,7 @@ struct expression_list *big_expression_stack;
 struct statement_list *big_statement_stack;
 int __in_pre_condition = 0;
 int __bail_on_rest_of_function = 0;
+int __in_prepass;
 char *get_function(void) { return cur_func; }
 int get_lineno(void) { return __smatch_lineno; }
 int inside_loop(void) { return !!loop_count; }
@@ -53,6 +56,12 @@ static void parse_inline(struct expression *expr);
 int option_assume_loops = 0;
 int option_known_conditions = 0;
 int option_two_passes = 0;
+
+static int stats_functions;
+static long long stats_states;
+static int stats_hairy;
+static int stats_max_states;
+static char *stats_max_func;
 struct symbol *cur_func_sym = NULL;
 
 int outside_of_function(void)
@@ -125,6 +134,8 @@ int inlinable(struct expression *expr)
 
 	if (__inline_fn)  /* don't nest */
 		return 0;
+	if (__in_prepass)  /* inlining writes to the in-memory db */
+		return 0;
 
 	if (expr->type != EXPR_SYMBOL || !expr->symbol)
 		return 0;
@@ -326,14 +337,326 @@ static int is_forever_loop(struct statement *stmt)
 	return 0;
 }
 
-static int loop_num;
-static char *get_loop_name(int num)
+/*
+ * Before a loop is parsed for real we go through it quietly to see what
+ * the smatch extra values look like when they come back around to the top.
+ * The first time, the loop head gets the union of the values going in and
+ * the values coming back.  If that still isn't enough then anything which
+ * is still growing is widened to the min or max of its type.  The widened
+ * states are merged in as the path which comes back around to the top, so
+ * the real pass is true for every iteration and not just the first one.
+ *
+ * Only smatch_extra and the core modules it needs run in the pre-pass (see
+ * run_in_loop_prepass()), unless --two-passes wants every owner.  Nothing
+ * is printed, inlined or written to the in-memory db and whatever was
+ * ignored in the meantime is forgotten again at the end.
+ *
+ * Loops inside a pre-pass are only parsed once and loops nested more than
+ * MAX_WIDEN_DEPTH deep aren't widened, otherwise nested loops would get
+ * expensive.
+ */
+#define LOOP_PREPASSES 2
+#define MAX_WIDEN_DEPTH 3
+static int loop_depth;  /* loop_count is set to a million after a label */
+
+struct prepass_bak {
+	int final_pass;
+	int loop_count;
+	int nr_stmts;
+	int nr_ignores;
+};
+
+static void start_prepass(struct prepass_bak *bak, struct state_list *head)
+{
+	bak->final_pass = final_pass;
+	bak->loop_count = loop_count;
+	bak->nr_stmts = ptr_list_size((struct ptr_list *)big_statement_stack);
+	bak->nr_ignores = __get_nr_ignores();
+
+	final_pass = 0;  /* don't print anything */
+	__in_prepass++;
+	__start_prepass(head);
+}
+
+static struct state_list *end_prepass(struct prepass_bak *bak, const void *goto_key)
+{
+	struct state_list *back;
+
+	back = __end_prepass(goto_key);
+	__in_prepass--;
+
+	while (ptr_list_size((struct ptr_list *)big_statement_stack) > bak->nr_stmts)
+		delete_ptr_list_last((struct ptr_list **)&big_statement_stack);
+	__drop_ignores(bak->nr_ignores);
+	loop_count = bak->loop_count;
+	final_pass = bak->final_pass;
+	return back;
+}
+
+static struct state_list *run_loop_prepass(struct statement *stmt,
+					   struct state_list *head, int pre_loop)
+{
+	struct prepass_bak bak;
+
+	start_prepass(&bak, head);
+	__push_continues();
+	__push_breaks();
+	if (pre_loop) {
+		__split_whole_condition(stmt->iterator_pre_condition);
+		__split_stmt(stmt->iterator_statement);
+		__merge_continues();
+		__split_stmt(stmt->iterator_post_statement);
+	} else {
+		__split_stmt(stmt->iterator_statement);
+		__merge_continues();
+		__split_whole_condition(stmt->iterator_post_condition);
+	}
+	return end_prepass(&bak, NULL);
+}
+
+static int can_prepass_loop(struct statement *stmt, int pre_loop)
+{
+	if (__in_prepass || loop_depth > MAX_WIDEN_DEPTH || __path_is_null() ||
+	    out_of_memory() || __bail_on_rest_of_function)
+		return 0;
+	/* we never go into the loop so nothing comes back around */
+	if (pre_loop && implied_condition_false(stmt->iterator_pre_condition))
+		return 0;
+	return 1;
+}
+
+static void widen_loop_head(struct statement *stmt, struct sm_state *iterator, int pre_loop)
 {
-	char buf[256];
+	struct state_list *head, *back, *edge;
+	struct state_list *widened = NULL;
+	struct sm_state *sm;
+	int i;
+
+	if (!can_prepass_loop(stmt, pre_loop))
+		return;
+
+	head = clone_slist(__get_cur_slist());
+	__core_hooks_only = !option_two_passes;
+	for (i = 0; i < LOOP_PREPASSES; i++) {
+		back = run_loop_prepass(stmt, head, pre_loop);
+		if (!__extra_widen_loop(&head, &widened, back, iterator, i))
+			break;
+	}
+	__core_hooks_only = 0;
+	free_slist(&head);
 
-	snprintf(buf, 255, "-loop%d", num);
-	buf[255] = '\0';
-	return alloc_sname(buf);
+	if (!widened && !option_two_passes)
+		return;
+
+	/* with --two-passes every hook ran so keep all of it */
+	if (option_two_passes)
+		edge = back;
+	else
+		edge = __extra_back_edge(back, iterator);
+	FOR_EACH_PTR(widened, sm) {
+		set_state_slist(&edge, sm->owner, sm->name, sm->sym, sm->state);
+	} END_FOR_EACH_PTR(sm);
+	__merge_back_edge(edge);
+	if (edge != back)
+		free_slist(&edge);
+	free_slist(&widened);
+}
+
+/*
+ * --two-passes:  The code which can be reached again from further down the
+ * function, loop bodies and labels which have a goto after them, is parsed
+ * twice.  The first time is quiet and whatever comes back around is merged
+ * into the states for every owner before the real pass.  For loops that is
+ * the last loop pre-pass from widen_loop_head().  The rest of the function
+ * is only parsed once.
+ */
+static struct symbol_list *seen_labels;
+static struct symbol_list *backward_labels;
+
+static int symbol_in_list(struct symbol_list *list, struct symbol *sym)
+{
+	struct symbol *tmp;
+
+	FOR_EACH_PTR(list, tmp) {
+		if (tmp == sym)
+			return 1;
+	} END_FOR_EACH_PTR(tmp);
+	return 0;
+}
+
+static void find_backward_labels(struct statement *stmt);
+
+/* statement expressions can have labels and gotos as well */
+static void find_backward_labels_expr(struct expression *expr)
+{
+	struct expression *tmp;
+
+	if (!expr)
+		return;
+
+	switch (expr->type) {
+	case EXPR_STATEMENT:
+		find_backward_labels(expr->statement);
+		break;
+	case EXPR_PREOP:
+	case EXPR_POSTOP:
+		find_backward_labels_expr(expr->unop);
+		break;
+	case EXPR_BINOP:
+	case EXPR_COMMA:
+	case EXPR_COMPARE:
+	case EXPR_LOGICAL:
+	case EXPR_ASSIGNMENT:
+		find_backward_labels_expr(expr->left);
+		find_backward_labels_expr(expr->right);
+		break;
+	case EXPR_DEREF:
+		find_backward_labels_expr(expr->deref);
+		break;
+	case EXPR_CAST:
+	case EXPR_FORCE_CAST:
+	case EXPR_IMPLIED_CAST:
+		find_backward_labels_expr(expr->cast_expression);
+		break;
+	case EXPR_CONDITIONAL:
+	case EXPR_SELECT:
+		find_backward_labels_expr(expr->conditional);
+		find_backward_labels_expr(expr->cond_true);
+		find_backward_labels_expr(expr->cond_false);
+		break;
+	case EXPR_CALL:
+		find_backward_labels_expr(expr->fn);
+		FOR_EACH_PTR(expr->args, tmp) {
+			find_backward_labels_expr(tmp);
+		} END_FOR_EACH_PTR(tmp);
+		break;
+	case EXPR_INITIALIZER:
+		FOR_EACH_PTR(expr->expr_list, tmp) {
+			find_backward_labels_expr(tmp);
+		} END_FOR_EACH_PTR(tmp);
+		break;
+	case EXPR_IDENTIFIER:
+		find_backward_labels_expr(expr->ident_expression);
+		break;
+	case EXPR_INDEX:
+		find_backward_labels_expr(expr->idx_expression);
+		break;
+	case EXPR_POS:
+		find_backward_labels_expr(expr->init_expr);
+		break;
+	default:
+		break;
+	}
+}
+
+static void find_backward_labels(struct statement *stmt)
+{
+	struct statement *tmp;
+	struct symbol *sym;
+
+	if (!stmt)
+		return;
+
+	switch (stmt->type) {
+	case STMT_DECLARATION:
+		FOR_EACH_PTR(stmt->declaration, sym) {
+			find_backward_labels_expr(sym->initializer);
+		} END_FOR_EACH_PTR(sym);
+		break;
+	case STMT_EXPRESSION:
+		find_backward_labels_expr(stmt->expression);
+		break;
+	case STMT_RETURN:
+		find_backward_labels_expr(stmt->ret_value);
+		break;
+	case STMT_COMPOUND:
+		FOR_EACH_PTR(stmt->stmts, tmp) {
+			find_backward_labels(tmp);
+		} END_FOR_EACH_PTR(tmp);
+		break;
+	case STMT_IF:
+		find_backward_labels_expr(stmt->if_conditional);
+		find_backward_labels(stmt->if_true);
+		find_backward_labels(stmt->if_false);
+		break;
+	case STMT_ITERATOR:
+		find_backward_labels(stmt->iterator_pre_statement);
+		find_backward_labels_expr(stmt->iterator_pre_condition);
+		find_backward_labels(stmt->iterator_statement);
+		find_backward_labels(stmt->iterator_post_statement);
+		find_backward_labels_expr(stmt->iterator_post_condition);
+		break;
+	case STMT_SWITCH:
+		find_backward_labels_expr(stmt->switch_expression);
+		find_backward_labels(stmt->switch_statement);
+		break;
+	case STMT_CASE:
+		find_backward_labels(stmt->case_statement);
+		break;
+	case STMT_LABEL:
+		if (stmt->label_identifier)
+			add_symbol(&seen_labels, stmt->label_identifier);
+		find_backward_labels(stmt->label_statement);
+		break;
+	case STMT_GOTO:
+		if (stmt->goto_label && stmt->goto_label->type == SYM_LABEL &&
+		    symbol_in_list(seen_labels, stmt->goto_label) &&
+		    !symbol_in_list(backward_labels, stmt->goto_label))
+			add_symbol(&backward_labels, stmt->goto_label);
+		break;
+	default:
+		break;
+	}
+}
+
+static void setup_second_pass(struct symbol *base_type)
+{
+	free_ptr_list(&seen_labels);
+	free_ptr_list(&backward_labels);
+	if (!option_two_passes)
+		return;
+	find_backward_labels(base_type->stmt);
+	find_backward_labels(base_type->inline_stmt);
+}
+
+static int is_backward_label(struct statement *stmt)
+{
+	if (stmt->type != STMT_LABEL || !stmt->label_identifier ||
+	    !stmt->label_identifier->ident)
+		return 0;
+	return symbol_in_list(backward_labels, stmt->label_identifier);
+}
+
+/* parse from the label to the end of the block and see what the gotos saved */
+static void second_pass_label(struct statement_list *stmts, struct statement *label)
+{
+	struct symbol *label_sym = label->label_identifier;
+	struct prepass_bak bak;
+	struct state_list *head, *back;
+	struct statement *tmp;
+	int found = 0;
+
+	if (__in_prepass || out_of_memory() || __bail_on_rest_of_function)
+		return;
+
+	__merge_gotos(label_sym);
+	if (__path_is_null())
+		return;
+
+	head = clone_slist(__get_cur_slist());
+	start_prepass(&bak, head);
+	FOR_EACH_PTR(stmts, tmp) {
+		if (tmp == label) {
+			found = 1;
+			__split_stmt(label->label_statement);
+			continue;
+		}
+		if (found)
+			__split_stmt(tmp);
+	} END_FOR_EACH_PTR(tmp);
+	back = end_prepass(&bak, label_sym);
+	__merge_back_edge(back);
+	free_slist(&head);
 }
 
 /*
@@ -344,24 +667,23 @@ static void handle_pre_loop(struct statement *stmt)
 	int once_through; /* we go through the loop at least once */
 	struct sm_state *extra_sm = NULL;
 	int unchanged = 0;
-	char *loop_name;
 	struct state_list *slist = NULL;
 	struct sm_state *sm = NULL;
 
-	loop_name = get_loop_name(loop_num);
-	loop_num++;
 
 	__split_stmt(stmt->iterator_pre_statement);
 
 	once_through = implied_condition_true(stmt->iterator_pre_condition);
 
 	loop_count++;
+	loop_depth++;
 	__push_continues();
 	__push_breaks();
 
-	__merge_gotos(loop_name);
+	__merge_gotos(stmt);
 
 	extra_sm = __extra_handle_canonical_loops(stmt, &slist);
+	widen_loop_head(stmt, extra_sm, 1);
 	__in_pre_condition++;
 	__pass_to_client(stmt, PRELOOP_HOOK);
 	__split_whole_condition(stmt->iterator_pre_condition);
@@ -381,7 +703,7 @@ static void handle_pre_loop(struct statement *stmt)
 	if (is_forever_loop(stmt)) {
 		struct state_list *slist;
 
-		__save_gotos(loop_name);
+		__save_gotos(stmt);
 
 		__push_fake_cur_slist();
 		__split_stmt(stmt->iterator_post_statement);
@@ -398,7 +720,7 @@ static void handle_pre_loop(struct statement *stmt)
 		__merge_continues();
 		unchanged = __iterator_unchanged(extra_sm);
 		__split_stmt(stmt->iterator_post_statement);
-		__save_gotos(loop_name);
+		__save_gotos(stmt);
 		__split_whole_condition(stmt->iterator_pre_condition);
 		nullify_path();
 		__merge_false_states();
@@ -414,6 +736,7 @@ static void handle_pre_loop(struct statement *stmt)
 		__merge_breaks();
 	}
 	loop_count--;
+	loop_depth--;
 }
 
 /*
@@ -421,19 +744,18 @@ static void handle_pre_loop(struct statement *stmt)
  */
 static void handle_post_loop(struct statement *stmt)
 {
-	char *loop_name;
 
-	loop_name = get_loop_name(loop_num);
-	loop_num++;
 	loop_count++;
+	loop_depth++;
 
 	__push_continues();
 	__push_breaks();
-	__merge_gotos(loop_name);
+	__merge_gotos(stmt);
+	widen_loop_head(stmt, NULL, 0);
 	__split_stmt(stmt->iterator_statement);
 	__merge_continues();
 	if (!is_zero(stmt->iterator_post_condition))
-		__save_gotos(loop_name);
+		__save_gotos(stmt);
 
 	if (is_forever_loop(stmt)) {
 		__use_breaks();
@@ -443,6 +765,7 @@ static void handle_post_loop(struct statement *stmt)
 		__merge_breaks();
 	}
 	loop_count--;
+	loop_depth--;
 }
 
 static int empty_statement(struct statement *stmt)
@@ -622,8 +945,10 @@ void __split_stmt(struct statement *stmt)
 	if (out_of_memory() || __bail_on_rest_of_function) {
 		static char *printed = NULL;
 
-		if (printed != cur_func)
+		if (printed != cur_func) {
 			sm_msg("Function too hairy.  Giving up.");
+			stats_hairy++;
+		}
 		final_pass = 0;  /* turn off sm_msg() from here */
 		printed = cur_func;
 		return;
@@ -654,6 +979,8 @@ void __split_stmt(struct statement *stmt)
 			last_stmt = last_ptr_list((struct ptr_list *)stmt->stmts);
 		__push_scope_hooks();
 		FOR_EACH_PTR(stmt->stmts, tmp) {
+			if (backward_labels && is_backward_label(tmp))
+				second_pass_label(stmt->stmts, tmp);
 			__split_stmt(tmp);
 		} END_FOR_EACH_PTR(tmp);
 		__call_scope_hooks();
@@ -736,7 +1063,7 @@ void __split_stmt(struct statement *stmt)
 		    stmt->label_identifier->type == SYM_LABEL &&
 		    stmt->label_identifier->ident) {
 			loop_count = 1000000;
-			__merge_gotos(stmt->label_identifier->ident->name);
+			__merge_gotos(stmt->label_identifier);
 		}
 		__split_stmt(stmt->label_statement);
 		break;
@@ -752,7 +1079,7 @@ void __split_stmt(struct statement *stmt)
 		} else if (stmt->goto_label &&
 			   stmt->goto_label->type == SYM_LABEL &&
 			   stmt->goto_label->ident) {
-			__save_gotos(stmt->goto_label->ident->name);
+			__save_gotos(stmt->goto_label);
 		}
 		nullify_path();
 		break;
@@ -1086,6 +1413,7 @@ static void start_function_definition(struct symbol *sym)
 static void split_function(struct symbol *sym)
 {
 	struct symbol *base_type = get_base_type(sym);
+	int states = sm_state_count();
 
 	cur_func_sym = sym;
 	if (sym->ident)
@@ -1093,28 +1421,31 @@ static void split_function(struct symbol *sym)
 	__smatch_lineno = sym->pos.line;
 	last_stmt = NULL;
 	loop_count = 0;
+	loop_depth = 0;
 	sm_debug("new function:  %s\n", cur_func);
 	__slist_id = 0;
-	if (option_two_passes) {
-		__unnullify_path();
-		loop_num = 0;
-		final_pass = 0;
-		start_function_definition(sym);
-		__split_stmt(base_type->stmt);
-		__split_stmt(base_type->inline_stmt);
-		nullify_path();
-	}
+	if (option_mem_stats)
+		mem_stats_function_start();
+	setup_second_pass(base_type);
 	__unnullify_path();
-	loop_num = 0;
 	start_function_definition(sym);
 	__split_stmt(base_type->stmt);
 	__split_stmt(base_type->inline_stmt);
 	__pass_to_client(sym, END_FUNC_HOOK);
 	__pass_to_client(sym, AFTER_FUNC_HOOK);
+	states = sm_state_count() - states;
+	stats_functions++;
+	stats_states += states;
+	if (states > stats_max_states) {
+		stats_max_states = states;
+		stats_max_func = cur_func;
+	}
+	if (option_mem_stats)
+		mem_stats_function_end(cur_func);
 	cur_func_sym = NULL;
 	cur_func = NULL;
 	clear_all_states();
-	free_data_info_allocs();
+	free_function_arena();
 	free_expression_stack(&switch_expr_stack);
 	__free_ptr_list((struct ptr_list **)&big_statement_stack);
 	__bail_on_rest_of_function = 0;
@@ -1123,7 +1454,6 @@ static void split_function(struct symbol *sym)
 static void parse_inline(struct expression *call)
 {
 	struct symbol *base_type;
-	int loop_num_bak = loop_num;
 	int final_pass_bak = final_pass;
 	char *cur_func_bak = cur_func;
 	struct statement_list *big_statement_stack_bak = big_statement_stack;
@@ -1151,7 +1481,6 @@ static void parse_inline(struct expression *call)
 
 	sm_debug("inline function:  %s\n", cur_func);
 	__unnullify_path();
-	loop_num = 0;
 	start_function_definition(call->fn->symbol);
 	__split_stmt(base_type->stmt);
 	__split_stmt(base_type->inline_stmt);
@@ -1162,7 +1491,6 @@ static void parse_inline(struct expression *call)
 	__free_ptr_list((struct ptr_list **)&big_statement_stack);
 	nullify_path();
 
-	loop_num = loop_num_bak;
 	final_pass = final_pass_bak;
 	cur_func_sym = cur_func_sym_bak;
 	cur_func = cur_func_bak;
@@ -1196,6 +1524,7 @@ static void process_inlines()
 	struct symbol *tmp;
 
 	FOR_EACH_PTR(inlines_called, tmp) {
+		job_start_inline(tmp);
 		split_function(tmp);
 	} END_FOR_EACH_PTR(tmp);
 	free_ptr_list(&inlines_called);
@@ -1257,22 +1586,115 @@ static void split_inlines(struct symbol_list *sym_list)
 		split_inlines_in_scope(sym);
 }
 
+static int is_func_definition(struct symbol *sym)
+{
+	return sym->type == SYM_NODE && get_base_type(sym)->type == SYM_FN;
+}
+
+/*
+ * What the --jobs workers and --snapshot children send back for --stats.
+ * The children allocate their own function names so copy it.
+ */
+struct job_stats {
+	int functions;
+	long long states;
+	int hairy;
+	int max_states;
+	char max_func[80];
+};
+
+static void get_job_stats(struct job_stats *stats)
+{
+	stats->functions = stats_functions;
+	stats->states = stats_states;
+	stats->hairy = stats_hairy;
+	stats->max_states = stats_max_states;
+	snprintf(stats->max_func, sizeof(stats->max_func), "%s",
+		 stats_max_func ? stats_max_func : "-");
+}
+
+static void job_stats_since(struct job_stats *before, struct job_stats *after)
+{
+	get_job_stats(after);
+	after->functions -= before->functions;
+	after->states -= before->states;
+	after->hairy -= before->hairy;
+}
+
+static void merge_job_stats(void *data)
+{
+	struct job_stats *stats = data;
+
+	stats_functions += stats->functions;
+	stats_states += stats->states;
+	stats_hairy += stats->hairy;
+	if (stats->max_states > stats_max_states) {
+		stats_max_states = stats->max_states;
+		stats_max_func = alloc_string(stats->max_func);
+	}
+}
+
 static void split_functions(struct symbol_list *sym_list)
 {
+	struct job_stats before, after;
 	struct symbol *sym;
+	int nr_functions = 0;
+	int unit = 0;
 
 	FOR_EACH_PTR(sym_list, sym) {
+		if (is_func_definition(sym))
+			nr_functions++;
+	} END_FOR_EACH_PTR(sym);
+
+	get_job_stats(&before);
+	if (jobs_fork(nr_functions, &after, sizeof(after), merge_job_stats))
+		return;
+
+	FOR_EACH_PTR(sym_list, sym) {
+		if (is_func_definition(sym) && !job_owns_unit(unit)) {
+			unit++;
+			continue;
+		}
+		if (job_owns_unit(unit))
+			job_start_unit(unit);
 		set_position(sym->pos);
-		if (sym->type == SYM_NODE && get_base_type(sym)->type == SYM_FN) {
+		if (is_func_definition(sym)) {
 			split_function(sym);
 			process_inlines();
 		} else {
 			__pass_to_client(sym, BASE_HOOK);
 			fake_global_assign(sym);
 		}
+		job_end_record();
+		unit++;
 	} END_FOR_EACH_PTR(sym);
-	split_inlines(sym_list);
-	__pass_to_client(sym_list, END_FILE_HOOK);
+
+	if (job_owns_unit(unit)) {
+		job_start_unit(unit);
+		split_inlines(sym_list);
+		__pass_to_client(sym_list, END_FILE_HOOK);
+		job_end_record();
+	}
+
+	job_stats_since(&before, &after);
+	jobs_finish(&after, sizeof(after));
+}
+
+/* --stats is what "make bench" reads so keep it to one line. */
+static void print_stats(struct timeval *start)
+{
+	struct timeval end;
+	struct rusage usage;
+
+	gettimeofday(&end, NULL);
+	getrusage(RUSAGE_SELF, &usage);
+	fprintf(stderr, "smatch stats: time=%.3f rss_kb=%ld functions=%d "
+		"sm_states=%lld max_states=%d max_func=%s too_hairy=%d\n",
+		(end.tv_sec - start->tv_sec) +
+		(end.tv_usec - start->tv_usec) / 1000000.0,
+		usage.ru_maxrss, stats_functions, stats_states,
+		stats_max_states, stats_max_func ? stats_max_func : "-",
+		stats_hairy);
 }
 
 void smatch(int argc, char **argv)
@@ -1280,12 +1702,17 @@ void smatch(int argc, char **argv)
 
 	struct string_list *filelist = NULL;
 	struct symbol_list *sym_list;
+	struct job_stats before, after;
+	struct timeval start;
+	int nr_files;
 
+	gettimeofday(&start, NULL);
 	if (argc < 2) {
 		printf("Usage:  smatch [--debug] <filename.c>\n");
 		exit(1);
 	}
 	sparse_initialize(argc, argv, &filelist);
+	nr_files = ptr_list_size((struct ptr_list *)filelist);
 	FOR_EACH_PTR_NOTAG(filelist, base_file) {
 		if (option_file_output) {
 			char buf[256];
@@ -1296,8 +1723,19 @@ void smatch(int argc, char **argv)
 				printf("Error:  Cannot open %s\n", base_file);
 				exit(1);
 			}
+			sm_output_init(sm_outfd);
 		}
+		get_job_stats(&before);
+		if (snapshot_fork(nr_files, &after, sizeof(after), merge_job_stats))
+			continue;
 		sym_list = sparse_keep_tokens(base_file);
 		split_functions(sym_list);
+		if (option_mem_stats)
+			mem_stats_file_end(base_file);
+		job_stats_since(&before, &after);
+		snapshot_finish(&after, sizeof(after));
 	} END_FOR_EACH_PTR_NOTAG(base_file);
+
+	if (option_stats)
+		print_stats(&start);
 }
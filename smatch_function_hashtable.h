@@ -69,6 +69,51 @@ static inline void destroy_function_hashtable(struct hashtable *table)
 	static DEFINE_HASHTABLE_REMOVE(remove_##_name, char, _list_type); \
 	static DEFINE_FUNCTION_ADD_HOOK(_name, _item_type, _list_type);
 
+/*
+ * Identifiers are interned by the tokenizer so two idents with the same name
+ * are the same pointer.  The ident tables hash the pointer instead of the
+ * string.  The keys belong to the tokenizer so we never remove anything from
+ * these tables (remove frees the key).
+ */
+static inline unsigned int ident_ptr_hash(void *ky)
+{
+	unsigned long p = (unsigned long)ky;
+
+	return (p >> 4) ^ (p >> 20);
+}
+
+static inline int equalidents(void *k1, void *k2)
+{
+	return k1 == k2;
+}
+
+static inline struct hashtable *create_ident_hashtable(int size)
+{
+	return create_hashtable(size, ident_ptr_hash, equalidents);
+}
+
+#define DEFINE_IDENT_ADD_HOOK(_name, _item_type, _list_type)    \
+void add_##_name(struct hashtable *table, const char *look_for, _item_type *value) \
+{                                                               \
+	_list_type *list;                                       \
+	struct ident *key;                                      \
+                                                                \
+	key = built_in_ident(look_for);                         \
+	list = search_##_name(table, key);                      \
+	if (list) {                                             \
+		/* the head of a non-empty ptr list never moves */ \
+		add_ptr_list(&list, value);                     \
+		return;                                         \
+	}                                                       \
+	add_ptr_list(&list, value);                             \
+	insert_##_name(table, key, list);                       \
+}
+
+#define DEFINE_IDENT_HASHTABLE_STATIC(_name, _item_type, _list_type)   \
+	static DEFINE_HASHTABLE_INSERT(insert_##_name, struct ident, _list_type); \
+	static DEFINE_HASHTABLE_SEARCH(search_##_name, struct ident, _list_type); \
+	static DEFINE_IDENT_ADD_HOOK(_name, _item_type, _list_type);
+
 #define DEFINE_STRING_HASHTABLE_STATIC(_name)   \
 	static DEFINE_HASHTABLE_INSERT(insert_##_name, char, int); \
 	static DEFINE_HASHTABLE_SEARCH(search_##_name, char, int); \
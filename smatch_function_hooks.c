@@ -27,6 +27,7 @@
 
 struct fcall_back {
 	int type;
+	int owner;
 	struct data_range *range;
 	union {
 		func_hook *call_back;
@@ -39,7 +40,7 @@ struct fcall_back {
 ALLOCATOR(fcall_back, "call backs");
 DECLARE_PTR_LIST(call_back_list, struct fcall_back);
 
-DEFINE_FUNCTION_HASHTABLE_STATIC(callback, struct fcall_back, struct call_back_list);
+DEFINE_IDENT_HASHTABLE_STATIC(callback, struct fcall_back, struct call_back_list);
 static struct hashtable *func_hash;
 
 #define REGULAR_CALL       0
@@ -51,6 +52,7 @@ static struct hashtable *func_hash;
 
 struct return_implies_callback {
 	int type;
+	int owner;
 	return_implies_hook *callback;
 };
 ALLOCATOR(return_implies_callback, "return_implies callbacks");
@@ -69,6 +71,7 @@ static struct fcall_back *alloc_fcall_back(int type, void *call_back,
 
 	cb = __alloc_fcall_back(0);
 	cb->type = type;
+	cb->owner = __cur_check;
 	cb->u.call_back = call_back;
 	cb->info = info;
 	return cb;
@@ -134,6 +137,7 @@ void select_return_states_hook(int type, return_implies_hook *callback)
 	struct return_implies_callback *cb = __alloc_return_implies_callback(0);
 
 	cb->type = type;
+	cb->owner = __cur_check;
 	cb->callback = callback;
 	add_ptr_list(&db_return_states_list, cb);
 }
@@ -170,18 +174,34 @@ static void call_return_states_after_hooks(void)
 	} END_FOR_EACH_PTR(fn);
 }
 
+static struct call_back_list *get_call_backs(const char *fn)
+{
+	struct ident *ident;
+
+	if (!fn)
+		return NULL;
+	/* if nothing by that name was interned then no hook was registered */
+	ident = lookup_ident(fn);
+	if (!ident)
+		return NULL;
+	return search_callback(func_hash, ident);
+}
+
 static int call_call_backs(struct call_back_list *list, int type,
 			    const char *fn, struct expression *expr)
 {
 	struct fcall_back *tmp;
+	int prev_check = __cur_check;
 	int handled = 0;
 
 	FOR_EACH_PTR(list, tmp) {
-		if (tmp->type == type) {
+		if (tmp->type == type && __hook_enabled(tmp->owner)) {
+			__cur_check = tmp->owner;
 			(tmp->u.call_back)(fn, expr, tmp->info);
 			handled = 1;
 		}
 	} END_FOR_EACH_PTR(tmp);
+	__cur_check = prev_check;
 
 	return handled;
 }
@@ -191,10 +211,15 @@ static void call_ranged_call_backs(struct call_back_list *list,
 				struct expression *assign_expr)
 {
 	struct fcall_back *tmp;
+	int prev_check = __cur_check;
 
 	FOR_EACH_PTR(list, tmp) {
+		if (!__hook_enabled(tmp->owner))
+			continue;
+		__cur_check = tmp->owner;
 		(tmp->u.ranged)(fn, call_expr, assign_expr, tmp->info);
 	} END_FOR_EACH_PTR(tmp);
+	__cur_check = prev_check;
 }
 
 static struct call_back_list *get_same_ranged_call_backs(struct call_back_list *list,
@@ -290,7 +315,7 @@ static int call_implies_callbacks(int comparison, struct expression *expr, sval_
 	if (expr->fn->type != EXPR_SYMBOL || !expr->fn->symbol)
 		return 0;
 	fn = expr->fn->symbol->ident->name;
-	call_backs = search_callback(func_hash, (char *)expr->fn->symbol->ident->name);
+	call_backs = search_callback(func_hash, expr->fn->symbol->ident);
 	if (!call_backs)
 		return 0;
 	value_range = alloc_range(sval, sval);
@@ -298,7 +323,7 @@ static int call_implies_callbacks(int comparison, struct expression *expr, sval_
 	/* set true states */
 	__push_fake_cur_slist();
 	FOR_EACH_PTR(call_backs, tmp) {
-		if (tmp->type != RANGED_CALL)
+		if (tmp->type != RANGED_CALL || !__hook_enabled(tmp->owner))
 			continue;
 		if (!true_comparison_range_LR(comparison, tmp->range, value_range, left))
 			continue;
@@ -311,7 +336,7 @@ static int call_implies_callbacks(int comparison, struct expression *expr, sval_
 	/* set false states */
 	__push_fake_cur_slist();
 	FOR_EACH_PTR(call_backs, tmp) {
-		if (tmp->type != RANGED_CALL)
+		if (tmp->type != RANGED_CALL || !__hook_enabled(tmp->owner))
 			continue;
 		if (!false_comparison_range_LR(comparison, tmp->range, value_range, left))
 			continue;
@@ -373,7 +398,7 @@ static int db_compare_callback(void *unused, int argc, char **argv, char **azCol
 	}
 
 	FOR_EACH_PTR(db_info.callbacks, tmp) {
-		if (tmp->type == type)
+		if (tmp->type == type && __hook_enabled(tmp->owner))
 			tmp->callback(db_info.expr, param, key, value);
 	} END_FOR_EACH_PTR(tmp);
 	return 0;
@@ -463,7 +488,7 @@ static int db_assign_return_states_callback(void *unused, int argc, char **argv,
 	prev_return_id = return_id;
 
 	FOR_EACH_PTR(db_return_states_list, tmp) {
-		if (tmp->type == type)
+		if (tmp->type == type && __hook_enabled(tmp->owner))
 			tmp->callback(db_info.expr, param, key, value);
 	} END_FOR_EACH_PTR(tmp);
 	ret_range = cast_rl(get_type(db_info.expr->left), ret_range);
@@ -536,7 +561,7 @@ static void match_assign_call(struct expression *expr)
 	 * call them in order from least important to most important.
 	 */
 
-	call_backs = search_callback(func_hash, (char *)fn);
+	call_backs = search_callback(func_hash, right->fn->symbol->ident);
 	call_call_backs(call_backs, ASSIGN_CALL, fn, expr);
 
 	handled |= db_return_states_assign(expr);
@@ -583,7 +608,7 @@ static int db_return_states_callback(void *unused, int argc, char **argv, char *
 	prev_return_id = return_id;
 
 	FOR_EACH_PTR(db_return_states_list, tmp) {
-		if (tmp->type == type)
+		if (tmp->type == type && __hook_enabled(tmp->owner))
 			tmp->callback(db_info.expr, param, key, value);
 	} END_FOR_EACH_PTR(tmp);
 
@@ -647,7 +672,7 @@ static void match_function_call(struct expression *expr)
 
 	if (expr->fn->type != EXPR_SYMBOL || !expr->fn->symbol)
 		return;
-	call_backs = search_callback(func_hash, (char *)expr->fn->symbol->ident->name);
+	call_backs = search_callback(func_hash, expr->fn->symbol->ident);
 	if (call_backs)
 		call_call_backs(call_backs, REGULAR_CALL,
 				expr->fn->symbol->ident->name, expr);
@@ -662,7 +687,7 @@ static void match_macro_assign(struct expression *expr)
 
 	right = strip_expr(expr->right);
 	macro = get_macro_name(right->pos);
-	call_backs = search_callback(func_hash, (char *)macro);
+	call_backs = get_call_backs(macro);
 	if (!call_backs)
 		return;
 	call_call_backs(call_backs, MACRO_ASSIGN, macro, expr);
@@ -679,14 +704,19 @@ int get_implied_return(struct expression *expr, struct range_list **rl)
 	*rl = NULL;
 
 	expr = strip_expr(expr);
-	fn = expr_to_var(expr->fn);
-	if (!fn)
-		goto out;
-
-	call_backs = search_callback(func_hash, fn);
+	if (expr->fn && expr->fn->type == EXPR_SYMBOL && expr->fn->symbol &&
+	    expr->fn->symbol->ident) {
+		call_backs = search_callback(func_hash, expr->fn->symbol->ident);
+		fn = NULL;
+	} else {
+		fn = expr_to_var(expr->fn);
+		if (!fn)
+			goto out;
+		call_backs = get_call_backs(fn);
+	}
 
 	FOR_EACH_PTR(call_backs, tmp) {
-		if (tmp->type == IMPLIED_RETURN) {
+		if (tmp->type == IMPLIED_RETURN && __hook_enabled(tmp->owner)) {
 			(tmp->u.implied_return)(expr, tmp->info, rl);
 			handled = 1;
 		}
@@ -699,11 +729,14 @@ out:
 
 void create_function_hook_hash(void)
 {
-	func_hash = create_function_hashtable(5000);
+	/* hooks are keyed by ident so the builtin idents must exist first */
+	init_builtin_idents();
+	func_hash = create_ident_hashtable(5000);
 }
 
 void register_function_hooks(int id)
 {
+	run_in_loop_prepass(id);
 	add_hook(&match_function_call, CALL_HOOK_AFTER_INLINE);
 	add_hook(&match_assign_call, CALL_ASSIGNMENT_HOOK);
 	add_hook(&match_macro_assign, MACRO_ASSIGNMENT_HOOK);
@@ -9,6 +9,35 @@
 
 #include "smatch.h"
 
+/*
+ * The check whose hook is running right now, or zero for the core.  The
+ * owner is recorded when the hook is registered.  It's used to say which
+ * check printed a message.
+ */
+int __cur_check;
+
+/*
+ * The quiet loop pre-pass in smatch_flow.c only wants the smatch_extra
+ * values.  While __core_hooks_only is set, only the core (owner zero) and
+ * the owners which called run_in_loop_prepass() get their hooks called.
+ */
+int __core_hooks_only;
+static unsigned char *prepass_owners;
+
+void run_in_loop_prepass(int client_id)
+{
+	if (!prepass_owners)
+		prepass_owners = calloc(num_checks + 1, sizeof(*prepass_owners));
+	prepass_owners[client_id] = 1;
+}
+
+int __hook_enabled(int owner)
+{
+	if (!__core_hooks_only || owner == 0)
+		return 1;
+	return prepass_owners && owner <= num_checks && prepass_owners[owner];
+}
+
 enum data_type {
 	EXPR_PTR,
 	STMT_PTR,
@@ -18,6 +47,7 @@ enum data_type {
 
 struct hook_container {
 	int hook_type;
+	int owner;
 	enum data_type data_type;
 	void *fn;
 };
@@ -40,6 +70,7 @@ void add_hook(void *func, enum hook_type type)
 {
 	struct hook_container *container = __alloc_hook_container(0);
 	container->hook_type = type;
+	container->owner = __cur_check;
 	container->fn = func;
 	switch (type) {
 	case EXPR_HOOK:
@@ -194,9 +225,12 @@ static void pass_sym_list_to_client(void *fn, void *data)
 void __pass_to_client(void *data, enum hook_type type)
 {
 	struct hook_container *container;
+	int prev_check = __cur_check;
 
 	FOR_EACH_PTR(hook_funcs, container) {
-		if (container->hook_type == type) {
+		if (container->hook_type == type &&
+		    __hook_enabled(container->owner)) {
+			__cur_check = container->owner;
 			switch (container->data_type) {
 			case EXPR_PTR:
 				pass_expr_to_client(container->fn, data);
@@ -213,16 +247,22 @@ void __pass_to_client(void *data, enum hook_type type)
 			}
 		}
 	} END_FOR_EACH_PTR(container);
+	__cur_check = prev_check;
 }
 
 void __pass_to_client_no_data(enum hook_type type)
 {
 	struct hook_container *container;
+	int prev_check = __cur_check;
 
 	FOR_EACH_PTR(hook_funcs, container) {
-		if (container->hook_type == type)
+		if (container->hook_type == type &&
+		    __hook_enabled(container->owner)) {
+			__cur_check = container->owner;
 			pass_to_client(container->fn);
+		}
 	} END_FOR_EACH_PTR(container);
+	__cur_check = prev_check;
 }
 
 void __pass_case_to_client(struct expression *switch_expr,
@@ -231,11 +271,16 @@ void __pass_case_to_client(struct expression *switch_expr,
 	typedef void (case_func)(struct expression *switch_expr,
 				 struct expression *case_expr);
 	struct hook_container *container;
+	int prev_check = __cur_check;
 
 	FOR_EACH_PTR(hook_funcs, container) {
-		if (container->hook_type == CASE_HOOK)
+		if (container->hook_type == CASE_HOOK &&
+		    __hook_enabled(container->owner)) {
+			__cur_check = container->owner;
 			((case_func *) container->fn)(switch_expr, case_expr);
+		}
 	} END_FOR_EACH_PTR(container);
+	__cur_check = prev_check;
 }
 
 int __has_merge_function(int client_id)
@@ -34,6 +34,28 @@ int is_ignored(int owner, const char *name, struct symbol *sym)
 	return 0;
 }
 
+/*
+ * The loop pre-passes and --two-passes parse code quietly before the real
+ * pass.  Anything they ignore has to be forgotten again or the real pass
+ * thinks it was already reported.
+ */
+int __get_nr_ignores(void)
+{
+	return ptr_list_size((struct ptr_list *)ignored);
+}
+
+void __drop_ignores(int nr)
+{
+	struct tracker *tmp;
+
+	while (ptr_list_size((struct ptr_list *)ignored) > nr) {
+		tmp = last_ptr_list((struct ptr_list *)ignored);
+		delete_ptr_list_last((struct ptr_list **)&ignored);
+		free_string(tmp->name);
+		free(tmp);
+	}
+}
+
 static void clear_ignores(void)
 {
 	if (__inline_fn)
@@ -43,7 +43,7 @@
  *    that is the pool where it was first set.  The my pool gets set when
  *    code paths merge.  States that have been set since the last merge do
  *    not have a ->pool.
- * merge_sm_state() sets ->left and ->right.  (These are the states which were
+ * merge_sm_state() sets sm_left() and sm_right().  (These are the states which were
  *    merged to form the current state.)
  * a pool:  a pool is an slist that has been merged with another slist.
  */
@@ -218,10 +218,10 @@ static void separate_pools(struct sm_state *sm_state, int comparison, struct ran
 	   so we bail.  Theoretically, bailing out here can cause more false
 	   positives but won't hide actual bugs.
 	*/
-	if (sm_state->nr_children > 4000) {
+	if (sm_nr_children(sm_state) > 4000) {
 		static char buf[1028];
 		snprintf(buf, sizeof(buf), "debug: separate_pools: nr_children over 4000 (%d). (%s %s)",
-			 sm_state->nr_children, sm_state->name, show_state(sm_state->state));
+			 sm_nr_children(sm_state), sm_state->name, show_state(sm_state->state));
 		implied_debug_msg = buf;
 		return;
 	}
@@ -236,12 +236,20 @@ static void separate_pools(struct sm_state *sm_state, int comparison, struct ran
 
 	do_compare(sm_state, comparison, vals, lr, true_stack, false_stack);
 
-	separate_pools(sm_state->left, comparison, vals, lr, true_stack, false_stack, checked);
-	separate_pools(sm_state->right, comparison, vals, lr, true_stack, false_stack, checked);
+	separate_pools(sm_left(sm_state), comparison, vals, lr, true_stack, false_stack, checked);
+	separate_pools(sm_right(sm_state), comparison, vals, lr, true_stack, false_stack, checked);
 	if (free_checked)
 		free_slist(checked);
 }
 
+/* this is separate_pools() for bench_smatch */
+void __separate_pools(struct sm_state *sm, int comparison, struct range_list *vals,
+		      struct state_list_stack **true_stack,
+		      struct state_list_stack **false_stack)
+{
+	separate_pools(sm, comparison, vals, LEFT, true_stack, false_stack, NULL);
+}
+
 struct sm_state *remove_pools(struct sm_state *sm,
 				struct state_list_stack *pools, int *modified)
 {
@@ -253,10 +261,10 @@ struct sm_state *remove_pools(struct sm_state *sm,
 	if (!sm)
 		return NULL;
 
-	if (sm->nr_children > 4000) {
+	if (sm_nr_children(sm) > 4000) {
 		static char buf[1028];
 		snprintf(buf, sizeof(buf), "debug: remove_pools: nr_children over 4000 (%d). (%s %s)",
-			 sm->nr_children, sm->name, show_state(sm->state));
+			 sm_nr_children(sm), sm->name, show_state(sm->state));
 		implied_debug_msg = buf;
 		return NULL;
 	}
@@ -272,9 +280,9 @@ struct sm_state *remove_pools(struct sm_state *sm,
 		return sm;
 	}
 
-	DIMPLIED("checking %s from %d (%d)\n", show_sm(sm), sm->line, sm->nr_children);
-	left = remove_pools(sm->left, pools, &removed);
-	right = remove_pools(sm->right, pools, &removed);
+	DIMPLIED("checking %s from %d (%d)\n", show_sm(sm), sm->line, sm_nr_children(sm));
+	left = remove_pools(sm_left(sm), pools, &removed);
+	right = remove_pools(sm_right(sm), pools, &removed);
 	if (!removed) {
 		DIMPLIED("kept %s from %d\n", show_sm(sm), sm->line);
 		return sm;
@@ -288,14 +296,12 @@ struct sm_state *remove_pools(struct sm_state *sm,
 	if (!left) {
 		ret = clone_sm(right);
 		ret->merged = 1;
-		ret->right = right;
-		ret->left = NULL;
+		set_sm_merge(ret, NULL, right);
 		ret->pool = sm->pool;
 	} else if (!right) {
 		ret = clone_sm(left);
 		ret->merged = 1;
-		ret->left = left;
-		ret->right = NULL;
+		set_sm_merge(ret, left, NULL);
 		ret->pool = sm->pool;
 	} else {
 		ret = merge_sm_states(left, right);
@@ -312,13 +318,13 @@ static int highest_slist_id(struct sm_state *sm)
 	int left = 0;
 	int right = 0;
 
-	if (!sm->left && !sm->right)
+	if (!sm_left(sm) && !sm_right(sm))
 		return 0;
 
-	if (sm->left)
-		left = get_slist_id(sm->left->pool);
-	if (sm->right)
-		right = get_slist_id(sm->right->pool);
+	if (sm_left(sm))
+		left = get_slist_id(sm_left(sm)->pool);
+	if (sm_right(sm))
+		right = get_slist_id(sm_right(sm)->pool);
 
 	if (right > left)
 		return right;
@@ -659,6 +665,7 @@ void overwrite_states_using_pool(struct sm_state *sm)
 void __extra_match_condition(struct expression *expr);
 void register_implications(int id)
 {
+	run_in_loop_prepass(id);
 	add_hook(&implied_states_hook, CONDITION_HOOK);
 	add_hook(&__extra_match_condition, CONDITION_HOOK);
 	add_hook(&match_end_func, END_FUNC_HOOK);
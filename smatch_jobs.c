@@ -0,0 +1,321 @@
+/*
+ * smatch/smatch_jobs.c
+ *
+ * Copyright (C) 2013 Oracle.
+ *
+ * Licensed under the Open Software License version 1.1
+ *
+ */
+
+/*
+ * --jobs=N splits the functions of a file between N worker processes.
+ *
+ * The parse is done once and then we fork so every worker starts with the
+ * same AST, DB handles and check state.  Smatch keeps all of its per
+ * function state in globals and none of the allocators are thread safe so
+ * processes are a lot less work than threads.
+ *
+ * Everything in the file is numbered, functions and global declarations,
+ * and "unit" N belongs to worker N % jobs.  All the workers go through the
+ * global declarations so the global assignment hooks see the same thing
+ * as they would normally but only the owner keeps the output.  One past the
+ * last symbol is the unit for the end of file stuff.
+ *
+ * The output is written to a temporary file for each worker along with an
+ * index of records.  When the workers are done the parent sorts the records
+ * by unit and prints them.  Inline functions are analyzed after the first
+ * function which calls them, but the workers don't know what the other
+ * workers have already done so the parent only prints the first one.
+ *
+ * --snapshot is the same trick one level up.  The -include headers are
+ * parsed once by sparse_initialize() and then every file on the command
+ * line is checked in a child process.  The fork gives each file its own
+ * copy on write copy of the symbol tables, macros and include guards so
+ * nothing one file declares leaks into the next one and the shared headers
+ * are never parsed again.
+ */
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include "smatch.h"
+
+int option_jobs;
+int option_snapshot;
+
+struct job_record {
+	int unit;
+	int worker;
+	int seq;
+	const void *key;
+	long start;
+	long len;
+};
+
+static int worker = -1;
+static FILE *job_out;
+static FILE *job_idx;
+static struct job_record cur_record;
+static int record_open;
+static int nr_records;
+static int snapshot_fd = -1;
+
+int job_owns_unit(int unit)
+{
+	if (!job_out)
+		return 1;
+	return unit % option_jobs == worker;
+}
+
+void job_end_record(void)
+{
+	if (!job_out || !record_open)
+		return;
+	cur_record.len = ftell(job_out) - cur_record.start;
+	if (cur_record.len)
+		fwrite(&cur_record, sizeof(cur_record), 1, job_idx);
+	record_open = 0;
+}
+
+static void start_record(int unit, const void *key)
+{
+	job_end_record();
+	cur_record.unit = unit;
+	cur_record.worker = worker;
+	cur_record.seq = nr_records++;
+	cur_record.key = key;
+	cur_record.start = ftell(job_out);
+	record_open = 1;
+}
+
+void job_start_unit(int unit)
+{
+	if (!job_out)
+		return;
+	start_record(unit, NULL);
+}
+
+void job_start_inline(const void *key)
+{
+	if (!job_out || !record_open)
+		return;
+	start_record(cur_record.unit, key);
+}
+
+void jobs_finish(const void *stats, int stats_size)
+{
+	struct job_record end = { .unit = -1 };
+
+	if (!job_out)
+		return;
+	job_end_record();
+	fwrite(&end, sizeof(end), 1, job_idx);
+	fwrite(stats, stats_size, 1, job_idx);
+	fflush(stdout);
+	fflush(stderr);
+	fflush(job_out);
+	fflush(job_idx);
+	_exit(ferror(job_out) || ferror(job_idx));
+}
+
+static int cmp_record(const void *a, const void *b)
+{
+	const struct job_record *one = a;
+	const struct job_record *two = b;
+
+	if (one->unit != two->unit)
+		return one->unit < two->unit ? -1 : 1;
+	if (one->seq != two->seq)
+		return one->seq < two->seq ? -1 : 1;
+	return 0;
+}
+
+static int already_printed(struct ptr_list **printed, const void *key)
+{
+	void *tmp;
+
+	FOR_EACH_PTR(*printed, tmp) {
+		if (tmp == key)
+			return 1;
+	} END_FOR_EACH_PTR(tmp);
+	__add_ptr_list(printed, (void *)key, 0);
+	return 0;
+}
+
+static void copy_output(FILE *from, long start, long len)
+{
+	char buf[4096];
+	size_t size;
+
+	fseek(from, start, SEEK_SET);
+	while (len > 0) {
+		size = len < sizeof(buf) ? len : sizeof(buf);
+		size = fread(buf, 1, size, from);
+		if (!size)
+			break;
+		fwrite(buf, 1, size, sm_outfd);
+		len -= size;
+	}
+}
+
+static void print_output(FILE **outs, FILE **idxs, int nr_workers, void *stats,
+			 int stats_size, void (*merge_stats)(void *stats))
+{
+	struct job_record *records = NULL;
+	struct ptr_list *printed = NULL;
+	struct job_record rec;
+	int nr = 0, alloc = 0;
+	int i;
+
+	for (i = 0; i < nr_workers; i++) {
+		rewind(idxs[i]);
+		while (fread(&rec, sizeof(rec), 1, idxs[i]) == 1) {
+			if (rec.unit == -1) {
+				if (fread(stats, stats_size, 1, idxs[i]) == 1)
+					merge_stats(stats);
+				break;
+			}
+			if (nr == alloc) {
+				alloc = alloc ? alloc * 2 : 256;
+				records = realloc(records, alloc * sizeof(*records));
+			}
+			records[nr++] = rec;
+		}
+	}
+
+	/* a unit only has one owner so the seq is enough to break ties */
+	qsort(records, nr, sizeof(*records), cmp_record);
+
+	for (i = 0; i < nr; i++) {
+		if (records[i].key && already_printed(&printed, records[i].key))
+			continue;
+		copy_output(outs[records[i].worker], records[i].start, records[i].len);
+	}
+
+	__free_ptr_list(&printed);
+	free(records);
+}
+
+/*
+ * Returns 1 in the parent once the workers have analyzed everything and the
+ * output has been printed.  Returns 0 in the workers and when we're not
+ * using workers for this file.
+ */
+int jobs_fork(int nr_functions, void *stats, int stats_size,
+	      void (*merge_stats)(void *stats))
+{
+	FILE *outs[option_jobs > 1 ? option_jobs : 1];
+	FILE *idxs[option_jobs > 1 ? option_jobs : 1];
+	int nr_workers;
+	int status;
+	pid_t pid;
+	int i;
+
+	/* the --info and --mem-stats data has to be collected in one place */
+	if (option_jobs < 2 || option_info || option_mem_stats)
+		return 0;
+	if (nr_functions < 2)
+		return 0;
+	nr_workers = option_jobs;
+
+	fflush(stdout);
+	fflush(stderr);
+	fflush(sm_outfd);
+
+	for (i = 0; i < nr_workers; i++) {
+		outs[i] = tmpfile();
+		idxs[i] = tmpfile();
+		if (!outs[i] || !idxs[i]) {
+			printf("Error:  Cannot create temporary files for --jobs\n");
+			exit(1);
+		}
+		pid = fork();
+		if (pid < 0) {
+			printf("Error:  fork() failed for --jobs\n");
+			exit(1);
+		}
+		if (pid == 0) {
+			worker = i;
+			job_idx = idxs[i];
+			job_out = outs[i];
+			/* the --debug output is printed straight to stdout */
+			if (sm_outfd == stdout) {
+				dup2(fileno(outs[i]), STDOUT_FILENO);
+				job_out = stdout;
+			}
+			sm_outfd = job_out;
+			sm_output_init(sm_outfd);
+			return 0;
+		}
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		if (wait(&status) < 0)
+			break;
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			fprintf(stderr, "smatch: a --jobs worker failed.  Output is incomplete.\n");
+	}
+
+	print_output(outs, idxs, nr_workers, stats, stats_size, merge_stats);
+
+	for (i = 0; i < nr_workers; i++) {
+		fclose(outs[i]);
+		fclose(idxs[i]);
+	}
+	return 1;
+}
+
+/*
+ * Returns 1 in the parent once the child has checked the file.  Returns 0 in
+ * the child and when there is only one file so there's nothing to protect.
+ */
+int snapshot_fork(int nr_files, void *stats, int stats_size,
+		  void (*merge_stats)(void *stats))
+{
+	int fds[2];
+	int status;
+	pid_t pid;
+
+	if (!option_snapshot || nr_files < 2)
+		return 0;
+
+	fflush(stdout);
+	fflush(stderr);
+	fflush(sm_outfd);
+
+	if (pipe(fds) < 0) {
+		printf("Error:  pipe() failed for --snapshot\n");
+		exit(1);
+	}
+	pid = fork();
+	if (pid < 0) {
+		printf("Error:  fork() failed for --snapshot\n");
+		exit(1);
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		snapshot_fd = fds[1];
+		return 0;
+	}
+
+	close(fds[1]);
+	/* the stats are a lot smaller than a pipe buffer */
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+		fprintf(stderr, "smatch: --snapshot child failed.  Output is incomplete.\n");
+	if (read(fds[0], stats, stats_size) == stats_size)
+		merge_stats(stats);
+	close(fds[0]);
+	return 1;
+}
+
+void snapshot_finish(const void *stats, int stats_size)
+{
+	int ret;
+
+	if (snapshot_fd < 0)
+		return;
+	ret = write(snapshot_fd, stats, stats_size) != stats_size;
+	fflush(stdout);
+	fflush(stderr);
+	fflush(sm_outfd);
+	_exit(ret || ferror(sm_outfd));
+}
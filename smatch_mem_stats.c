@@ -0,0 +1,210 @@
+/*
+ * smatch/smatch_mem_stats.c
+ *
+ * Copyright (C) 2013 Oracle.
+ *
+ * Licensed under the Open Software License version 1.1
+ *
+ */
+
+/*
+ * --mem-stats[=N] prints how much each allocator used for every file and
+ * the N functions which needed the most memory with a break down by
+ * allocator.  It goes to stderr.
+ *
+ * "cumul" is everything that was allocated, including what was freed and
+ * allocated again.  "peak" is how far the allocator's blobs grew past where
+ * they were when the function started.
+ *
+ * The identifier and include stream hash tables are printed last.
+ */
+
+#include "smatch.h"
+
+#define MAX_ALLOCATORS 256
+
+int option_mem_stats;
+
+struct alloc_usage {
+	unsigned long long allocations;
+	unsigned long long cumulative;
+	unsigned long long peak;
+};
+
+struct func_usage {
+	const char *name;
+	unsigned long long cumulative;
+	unsigned long long peak;
+	struct alloc_usage *allocs;
+	int nr_allocs;
+};
+
+static struct allocator_struct *allocs[MAX_ALLOCATORS];
+static int nr_allocs;
+
+static unsigned long long start_allocations[MAX_ALLOCATORS];
+static unsigned long long start_cumulative[MAX_ALLOCATORS];
+static unsigned int start_total[MAX_ALLOCATORS];
+
+static struct alloc_usage file_usage[MAX_ALLOCATORS];
+static struct func_usage *top_funcs;
+static int nr_top_funcs;
+static int nr_funcs;
+
+static unsigned long long cumulative_bytes(struct allocator_struct *desc)
+{
+	return desc->dropped_bytes + desc->useful_bytes;
+}
+
+static unsigned long long cumulative_allocations(struct allocator_struct *desc)
+{
+	return desc->dropped_allocations + desc->allocations;
+}
+
+/* new allocators are added to the front of all_allocators */
+static void update_allocators(void)
+{
+	struct allocator_struct *desc;
+	int count = 0;
+	int i;
+
+	for (desc = all_allocators; desc; desc = desc->next)
+		count++;
+	if (count == nr_allocs)
+		return;
+	if (count > MAX_ALLOCATORS)
+		count = MAX_ALLOCATORS;
+
+	i = count - 1;
+	for (desc = all_allocators; desc && i >= nr_allocs; desc = desc->next)
+		allocs[i--] = desc;
+	nr_allocs = count;
+}
+
+void mem_stats_function_start(void)
+{
+	int i;
+
+	update_allocators();
+	for (i = 0; i < nr_allocs; i++) {
+		start_allocations[i] = cumulative_allocations(allocs[i]);
+		start_cumulative[i] = cumulative_bytes(allocs[i]);
+		start_total[i] = allocs[i]->total_bytes;
+		allocs[i]->peak_bytes = allocs[i]->total_bytes;
+	}
+}
+
+static void add_top_function(const char *name, struct alloc_usage *usage,
+			     unsigned long long cumulative, unsigned long long peak)
+{
+	struct func_usage *func;
+	int i;
+
+	if (nr_top_funcs == option_mem_stats) {
+		func = &top_funcs[nr_top_funcs - 1];
+		if (peak <= func->peak)
+			return;
+		free(func->allocs);
+		nr_top_funcs--;
+	}
+
+	/* keep them sorted, biggest first */
+	for (i = nr_top_funcs; i > 0; i--) {
+		if (top_funcs[i - 1].peak >= peak)
+			break;
+		top_funcs[i] = top_funcs[i - 1];
+	}
+	func = &top_funcs[i];
+	func->name = name;
+	func->cumulative = cumulative;
+	func->peak = peak;
+	func->nr_allocs = nr_allocs;
+	func->allocs = malloc(nr_allocs * sizeof(*usage));
+	memcpy(func->allocs, usage, nr_allocs * sizeof(*usage));
+	nr_top_funcs++;
+}
+
+void mem_stats_function_end(const char *name)
+{
+	struct alloc_usage usage[MAX_ALLOCATORS];
+	unsigned long long cumulative = 0, peak = 0;
+	int i;
+
+	update_allocators();
+	for (i = 0; i < nr_allocs; i++) {
+		usage[i].allocations = cumulative_allocations(allocs[i]) - start_allocations[i];
+		usage[i].cumulative = cumulative_bytes(allocs[i]) - start_cumulative[i];
+		if (allocs[i]->peak_bytes > start_total[i])
+			usage[i].peak = allocs[i]->peak_bytes - start_total[i];
+		else
+			usage[i].peak = 0;
+
+		cumulative += usage[i].cumulative;
+		peak += usage[i].peak;
+		file_usage[i].allocations += usage[i].allocations;
+		file_usage[i].cumulative += usage[i].cumulative;
+		if (usage[i].peak > file_usage[i].peak)
+			file_usage[i].peak = usage[i].peak;
+	}
+	nr_funcs++;
+
+	if (!top_funcs)
+		top_funcs = malloc(option_mem_stats * sizeof(*top_funcs));
+	add_top_function(name ? name : "<anon>", usage, cumulative, peak);
+}
+
+static int cmp_usage(const void *a, const void *b)
+{
+	const struct alloc_usage *one = &file_usage[*(const int *)a];
+	const struct alloc_usage *two = &file_usage[*(const int *)b];
+
+	if (one->peak != two->peak)
+		return one->peak < two->peak ? 1 : -1;
+	if (one->cumulative != two->cumulative)
+		return one->cumulative < two->cumulative ? 1 : -1;
+	return 0;
+}
+
+void mem_stats_file_end(const char *file)
+{
+	int order[MAX_ALLOCATORS];
+	struct func_usage *func;
+	int i, j;
+
+	fprintf(stderr, "mem-stats: %s: %d functions\n", file, nr_funcs);
+	fprintf(stderr, "  %-32s %12s %12s %12s\n", "allocator", "allocs",
+		"cumul_kb", "peak_kb");
+	for (i = 0; i < nr_allocs; i++)
+		order[i] = i;
+	qsort(order, nr_allocs, sizeof(order[0]), cmp_usage);
+	for (i = 0; i < nr_allocs; i++) {
+		struct alloc_usage *usage = &file_usage[order[i]];
+
+		if (!usage->allocations && !usage->peak)
+			continue;
+		fprintf(stderr, "  %-32s %12llu %12llu %12llu\n",
+			allocs[order[i]]->name, usage->allocations,
+			usage->cumulative / 1024, usage->peak / 1024);
+	}
+
+	fprintf(stderr, "mem-stats: %s: top %d functions\n", file, nr_top_funcs);
+	for (i = 0; i < nr_top_funcs; i++) {
+		func = &top_funcs[i];
+		fprintf(stderr, "  %-32s %12s %12llu %12llu\n", func->name, "",
+			func->cumulative / 1024, func->peak / 1024);
+		for (j = 0; j < func->nr_allocs; j++) {
+			if (!func->allocs[j].peak && !func->allocs[j].allocations)
+				continue;
+			fprintf(stderr, "    %-30s %12llu %12llu %12llu\n",
+				allocs[j]->name, func->allocs[j].allocations,
+				func->allocs[j].cumulative / 1024,
+				func->allocs[j].peak / 1024);
+		}
+		free(func->allocs);
+	}
+	show_identifier_stats();
+
+	memset(file_usage, 0, sizeof(file_usage));
+	nr_top_funcs = 0;
+	nr_funcs = 0;
+}
@@ -66,7 +66,7 @@ static void call_modification_hooks_name_sym(char *name, struct symbol *sym, str
 	slist = __get_cur_slist();
 
 	FOR_EACH_PTR(slist, sm) {
-		if (sm->owner > num_checks)
+		if (sm->owner > num_checks || !__hook_enabled(sm->owner))
 			continue;
 		match = matches(name, sym, sm);
 
@@ -166,6 +166,7 @@ void register_modification_hooks(int id)
 	memset(hooks, 0, (num_checks + 1) * sizeof(*hooks));
 	indirect_hooks = malloc((num_checks + 1) * sizeof(*hooks));
 	memset(indirect_hooks, 0, (num_checks + 1) * sizeof(*hooks));
+	run_in_loop_prepass(id);
 
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_hook(&unop_expr, OP_HOOK);
@@ -174,6 +175,7 @@ void register_modification_hooks(int id)
 
 void register_modification_hooks_late(int id)
 {
+	run_in_loop_prepass(id);
 	add_hook(&match_call, FUNCTION_CALL_HOOK);
 	select_return_states_hook(ADDED_VALUE, &db_param_add);
 }
@@ -0,0 +1,203 @@
+/*
+ * smatch/smatch_output.c
+ *
+ * Copyright (C) 2013 Oracle.
+ *
+ * Licensed under the Open Software License version 1.1
+ *
+ */
+
+/*
+ * With --output=jsonl every line smatch would have printed becomes one JSON
+ * object instead:
+ *
+ * {"file":"foo.c","line":12,"function":"bar","function_line":8,
+ *  "check":"check_deref","type":"error",
+ *  "message":"potential null dereference 'p'."}
+ *
+ * sm_prefix() starts a record and the sm_printf() calls after it are
+ * collected until the newline, so the checks which build their messages
+ * piece by piece don't need to know about this.  The "warn: ", "error: ",
+ * "info: " and "SQL: " prefixes become the "type" field and the SQL inserts
+ * are split into "table" and "values".
+ *
+ * The "check" is the check which registered the hook we are in, see
+ * __cur_check.
+ */
+
+#include <stdarg.h>
+#include "smatch.h"
+
+#define SM_OUTPUT_BUFSIZE (1 << 20)
+
+int option_output_jsonl;
+
+static char *line_buf;
+static int line_len, line_alloc;
+
+static int have_prefix;
+static const char *rec_file;
+static const char *rec_func;
+static int rec_func_line;
+static int rec_line;
+static int rec_check;
+
+void sm_output_init(FILE *fd)
+{
+	if (option_output_jsonl)
+		setvbuf(fd, NULL, _IOFBF, SM_OUTPUT_BUFSIZE);
+}
+
+static void json_string(const char *str, int len)
+{
+	static const char hex[] = "0123456789abcdef";
+	const unsigned char *p = (const unsigned char *)str;
+	const unsigned char *end = p + len;
+
+	putc('"', sm_outfd);
+	for (; p < end; p++) {
+		switch (*p) {
+		case '"':
+			fputs("\\\"", sm_outfd);
+			break;
+		case '\\':
+			fputs("\\\\", sm_outfd);
+			break;
+		case '\t':
+			fputs("\\t", sm_outfd);
+			break;
+		default:
+			if (*p < 0x20) {
+				fputs("\\u00", sm_outfd);
+				putc(hex[*p >> 4], sm_outfd);
+				putc(hex[*p & 0xf], sm_outfd);
+			} else {
+				putc(*p, sm_outfd);
+			}
+		}
+	}
+	putc('"', sm_outfd);
+}
+
+static void json_field(const char *name, const char *str, int len)
+{
+	fprintf(sm_outfd, ",\"%s\":", name);
+	json_string(str, len);
+}
+
+static int starts_with(const char *str, const char *prefix)
+{
+	return !strncmp(str, prefix, strlen(prefix));
+}
+
+static void print_sql(const char *type, const char *msg, int len)
+{
+	const char *table, *values, *end = msg + len;
+
+	fprintf(sm_outfd, ",\"type\":\"%s\"", type);
+	if (!starts_with(msg, "insert into "))
+		goto raw;
+	table = msg + strlen("insert into ");
+	values = strstr(table, " values (");
+	if (!values || values >= end)
+		goto raw;
+	json_field("table", table, values - table);
+	values += strlen(" values (");
+	while (end > values && (end[-1] == ';' || end[-1] == ')'))
+		end--;
+	json_field("values", values, end - values);
+	return;
+raw:
+	json_field("message", msg, len);
+}
+
+static void print_record(const char *msg, int len)
+{
+	static const char *types[] = { "warn", "error", "info" };
+	const char *type = "msg";
+	int i;
+
+	fputs("{", sm_outfd);
+	if (have_prefix) {
+		fputs("\"file\":", sm_outfd);
+		json_string(rec_file, strlen(rec_file));
+		fprintf(sm_outfd, ",\"line\":%d", rec_line);
+		if (rec_func) {
+			json_field("function", rec_func, strlen(rec_func));
+			fprintf(sm_outfd, ",\"function_line\":%d", rec_func_line);
+		}
+	} else {
+		fputs("\"file\":", sm_outfd);
+		json_string(get_filename(), strlen(get_filename()));
+	}
+	fputs(",\"check\":", sm_outfd);
+	json_string(check_name(rec_check), strlen(check_name(rec_check)));
+
+	if (starts_with(msg, "SQL: ")) {
+		print_sql("sql", msg + 5, len - 5);
+		goto done;
+	}
+	if (starts_with(msg, "SQL_caller_info: ")) {
+		print_sql("sql_caller_info", msg + 17, len - 17);
+		goto done;
+	}
+	for (i = 0; i < ARRAY_SIZE(types); i++) {
+		int n = strlen(types[i]);
+
+		if (!strncmp(msg, types[i], n) && msg[n] == ':' && msg[n + 1] == ' ') {
+			type = types[i];
+			msg += n + 2;
+			len -= n + 2;
+			break;
+		}
+	}
+	fprintf(sm_outfd, ",\"type\":\"%s\"", type);
+	json_field("message", msg, len);
+done:
+	fputs("}\n", sm_outfd);
+}
+
+void sm_json_prefix(void)
+{
+	if (!final_pass && !option_debug)
+		return;
+	have_prefix = 1;
+	rec_file = get_filename();
+	rec_line = get_lineno();
+	rec_func = get_function();
+	rec_func_line = cur_func_sym ? cur_func_sym->pos.line : 0;
+	rec_check = __cur_check;
+}
+
+void sm_json_printf(const char *fmt, ...)
+{
+	va_list args;
+	char *start, *nl;
+	int len;
+
+	if (!line_buf) {
+		line_alloc = 4096;
+		line_buf = malloc(line_alloc);
+	}
+again:
+	va_start(args, fmt);
+	len = vsnprintf(line_buf + line_len, line_alloc - line_len, fmt, args);
+	va_end(args);
+	if (line_len + len >= line_alloc) {
+		line_alloc = (line_len + len) * 2;
+		line_buf = realloc(line_buf, line_alloc);
+		goto again;
+	}
+	line_len += len;
+
+	start = line_buf;
+	while ((nl = memchr(start, '\n', line_buf + line_len - start))) {
+		if (!have_prefix)
+			rec_check = __cur_check;
+		print_record(start, nl - start);
+		have_prefix = 0;
+		start = nl + 1;
+	}
+	line_len -= start - line_buf;
+	memmove(line_buf, start, line_len);
+}
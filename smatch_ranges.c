@@ -442,7 +442,7 @@ void add_range(struct range_list **list, sval_t min, sval_t max)
 	if (check_next)
 		return;
 	new = alloc_range(min, max);
-	add_ptr_list(list, new);
+	add_ptr_list_arena(list, new);
 }
 
 struct range_list *clone_rl(struct range_list *list)
@@ -451,7 +451,7 @@ struct range_list *clone_rl(struct range_list *list)
 	struct range_list *ret = NULL;
 
 	FOR_EACH_PTR(list, tmp) {
-		add_ptr_list(&ret, tmp);
+		add_ptr_list_arena(&ret, tmp);
 	} END_FOR_EACH_PTR(tmp);
 	return ret;
 }
@@ -757,7 +757,7 @@ int rl_has_sval(struct range_list *rl, sval_t sval)
 
 void tack_on(struct range_list **list, struct data_range *drange)
 {
-	add_ptr_list(list, drange);
+	add_ptr_list_arena(list, drange);
 }
 
 void push_rl(struct range_list_stack **rl_stack, struct range_list *rl)
@@ -993,38 +993,9 @@ void free_rl(struct range_list **rlist)
 	__free_ptr_list((struct ptr_list **)rlist);
 }
 
-static void free_single_dinfo(struct data_info *dinfo)
-{
-	free_rl(&dinfo->value_ranges);
-}
-
-static void free_dinfos(struct allocation_blob *blob)
-{
-	unsigned int size = sizeof(struct data_info);
-	unsigned int offset = 0;
-
-	while (offset < blob->offset) {
-		free_single_dinfo((struct data_info *)(blob->data + offset));
-		offset += size;
-	}
-}
-
 void free_data_info_allocs(void)
 {
-	struct allocator_struct *desc = &data_info_allocator;
-	struct allocation_blob *blob = desc->blobs;
-
-	desc->blobs = NULL;
-	desc->allocations = 0;
-	desc->total_bytes = 0;
-	desc->useful_bytes = 0;
-	desc->freelist = NULL;
-	while (blob) {
-		struct allocation_blob *next = blob->next;
-		free_dinfos(blob);
-		blob_free(blob, desc->chunking);
-		blob = next;
-	}
+	clear_data_info_alloc();
 	clear_data_range_alloc();
 }
 
@@ -0,0 +1,54 @@
+#!/bin/bash
+
+#
+# Generate the stress files with gen_stress.pl and time smatch on them.
+# Each kind is run at every size so you can see where it stops growing
+# linearly.
+#
+# Usage:  bench.sh [smatch options]
+#
+# The knobs are environment variables:
+#   BENCH_KINDS  which gen_stress.pl kinds to run
+#   BENCH_SIZES  the --size values
+#   BENCH_FUNCS  the number of functions in each file
+#   BENCH_DIR    where the generated files go
+#
+
+SCRIPT_DIR=$(dirname $0)
+SMATCH=$SCRIPT_DIR/../smatch
+if [ ! -x $SMATCH ] ; then
+    echo "Smatch binary not found.  Run make first."
+    exit 1
+fi
+
+KINDS=${BENCH_KINDS:-"ifs conditions switch gotos loops structs inline"}
+SIZES=${BENCH_SIZES:-"8 16 32 64"}
+FUNCS=${BENCH_FUNCS:-4}
+DIR=${BENCH_DIR:-smatch_bench}
+
+mkdir -p $DIR
+
+printf "%-12s %6s %9s %10s %10s %10s %6s\n" \
+    kind size seconds rss_kb sm_states max_states hairy
+
+for kind in $KINDS ; do
+    for size in $SIZES ; do
+        file=$DIR/${kind}_${size}.c
+        $SCRIPT_DIR/gen_stress.pl --kind=$kind --size=$size \
+            --funcs=$FUNCS > $file || exit 1
+
+        stats=$($SMATCH --stats "$@" $file 2>&1 >/dev/null | \
+                grep "^smatch stats:")
+        if [ "$stats" = "" ] ; then
+            printf "%-12s %6s  failed\n" $kind $size
+            continue
+        fi
+
+        field() {
+            echo "$stats" | sed -e "s/.* $1=\([^ ]*\).*/\1/"
+        }
+        printf "%-12s %6s %9s %10s %10s %10s %6s\n" $kind $size \
+            $(field time) $(field rss_kb) $(field sm_states) \
+            $(field max_states) $(field too_hairy)
+    done
+done
@@ -0,0 +1,206 @@
+#!/usr/bin/perl
+
+# Generate C files which are hard work for smatch.  The output is used by
+# "make bench" to see how the time and memory grow as the functions get
+# bigger.  Every kind takes a size knob and the number of functions.
+
+use strict;
+use Getopt::Long;
+
+my $kind = "";
+my $size = 10;
+my $funcs = 1;
+
+sub usage()
+{
+    print("gen_stress.pl --kind=<kind> [--size=N] [--funcs=N]\n");
+    print("kinds:  ifs, conditions, switch, gotos, loops, structs, inline\n");
+    exit(1);
+}
+
+GetOptions("kind=s" => \$kind, "size=i" => \$size, "funcs=i" => \$funcs)
+    or usage();
+
+# if (a == 0) ... else if (a == 1) ... nested $size deep
+sub gen_ifs($)
+{
+    my $f = shift;
+
+    print("int ifs_$f(int a, int *p)\n{\n\tint x = 0;\n\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\t" x ($i + 1));
+	print("if (a == $i) {\n");
+	print("\t" x ($i + 2));
+	print("x = $i;\n");
+	print("\t" x ($i + 2));
+	print("p = 0;\n");
+	print("\t" x ($i + 1));
+	print("} else {\n");
+    }
+    print("\t" x ($size + 1));
+    print("x = -1;\n");
+    for (my $i = $size - 1; $i >= 0; $i--) {
+	print("\t" x ($i + 1));
+	print("}\n");
+    }
+    print("\tif (x > 0)\n\t\treturn *p;\n\treturn x;\n}\n\n");
+}
+
+# $size independent conditional assignments and then $size checks.  This is
+# the implications worst case, every check has to look back at every merge.
+sub gen_conditions($)
+{
+    my $f = shift;
+
+    print("int conditions_$f(int a, int *p)\n{\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tint x$i = 0;\n");
+    }
+    print("\tint *q = p;\n\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tif (a & (1 << ($i % 31)))\n\t\tx$i = $i + 1;\n");
+	if ($i % 4 == 0) {
+	    print("\telse\n\t\tq = 0;\n");
+	}
+    }
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tif (x$i)\n\t\ta += *q;\n");
+    }
+    print("\treturn a;\n}\n\n");
+}
+
+sub gen_switch($)
+{
+    my $f = shift;
+
+    print("int switch_$f(int a, int *p)\n{\n\tint x = 0, y = 0;\n\n");
+    print("\tswitch (a) {\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tcase $i:\n\t\tx = $i;\n");
+	if ($i % 3 == 0) {
+	    print("\t\ty = 1;\n");
+	}
+	if ($i % 5 == 0) {
+	    print("\t\tp = 0;\n");
+	}
+	if ($i % 2 == 0) {
+	    print("\t\tbreak;\n");
+	}
+    }
+    print("\tdefault:\n\t\treturn -1;\n\t}\n");
+    print("\tif (y)\n\t\treturn *p;\n\treturn x;\n}\n\n");
+}
+
+# kernel style error handling with an unwind ladder at the end
+sub gen_gotos($)
+{
+    my $f = shift;
+
+    print("int gotos_$f(int a, int *p)\n{\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tint *r$i;\n");
+    }
+    print("\tint ret = 0;\n\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tr$i = get_res(a + $i);\n");
+	print("\tif (!r$i) {\n\t\tret = -12;\n\t\tgoto err$i;\n\t}\n");
+    }
+    print("\treturn 0;\n\n");
+    for (my $i = $size - 1; $i >= 0; $i--) {
+	if ($i > 0) {
+	    my $prev = $i - 1;
+	    print("err$i:\n\tput_res(r$prev);\n");
+	} else {
+	    print("err$i:\n");
+	}
+    }
+    print("\treturn ret;\n}\n\n");
+}
+
+# loops nested $size deep with a few variables changing inside them
+sub gen_loops($)
+{
+    my $f = shift;
+
+    print("int loops_$f(int a, int *p)\n{\n\tint x = 0, y = 0;\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tint i$i;\n");
+    }
+    print("\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\t" x ($i + 1));
+	print("for (i$i = 0; i$i < a; i$i++) {\n");
+	print("\t" x ($i + 2));
+	print("if (i$i == $i)\n");
+	print("\t" x ($i + 3));
+	print("x++;\n");
+    }
+    print("\t" x ($size + 1));
+    print("if (x > y)\n");
+    print("\t" x ($size + 2));
+    print("y = *p;\n");
+    for (my $i = $size - 1; $i >= 0; $i--) {
+	print("\t" x ($i + 1));
+	print("}\n");
+    }
+    print("\treturn x + y;\n}\n\n");
+}
+
+# a struct with $size members which are set and tested through a pointer
+sub gen_structs($)
+{
+    my $f = shift;
+
+    print("struct wide_$f {\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tint m$i;\n\tint *ptr$i;\n");
+    }
+    print("};\n\n");
+    print("int structs_$f(struct wide_$f *s, int a)\n{\n\tint ret = 0;\n\n");
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tif (a > $i) {\n\t\ts->m$i = $i;\n\t\ts->ptr$i = 0;\n\t}\n");
+    }
+    for (my $i = 0; $i < $size; $i++) {
+	print("\tif (s->m$i == $i)\n\t\tret += *s->ptr$i;\n");
+    }
+    print("\treturn ret;\n}\n\n");
+}
+
+# a chain of $size inline helpers which all branch
+sub gen_inline($)
+{
+    my $f = shift;
+
+    print("static inline int inline_${f}_0(int a, int *p)\n{\n");
+    print("\tif (a < 0)\n\t\treturn -1;\n\treturn *p;\n}\n\n");
+    for (my $i = 1; $i < $size; $i++) {
+	my $prev = $i - 1;
+	print("static inline int inline_${f}_$i(int a, int *p)\n{\n");
+	print("\tif (a == $i)\n\t\tp = 0;\n");
+	print("\tif (a > $i)\n\t\treturn inline_${f}_$prev(a - 1, p);\n");
+	print("\treturn inline_${f}_$prev(a, p) + 1;\n}\n\n");
+    }
+    my $last = $size - 1;
+    print("int inline_$f(int a, int *p)\n{\n");
+    print("\treturn inline_${f}_$last(a, p);\n}\n\n");
+}
+
+my %gens = (
+    "ifs" => \&gen_ifs,
+    "conditions" => \&gen_conditions,
+    "switch" => \&gen_switch,
+    "gotos" => \&gen_gotos,
+    "loops" => \&gen_loops,
+    "structs" => \&gen_structs,
+    "inline" => \&gen_inline,
+);
+
+if (!defined($gens{$kind}) || $size < 1 || $funcs < 1) {
+    usage();
+}
+
+print("/* generated by gen_stress.pl --kind=$kind --size=$size --funcs=$funcs */\n\n");
+print("int *get_res(int a);\nvoid put_res(int *r);\n\n");
+for (my $f = 0; $f < $funcs; $f++) {
+    $gens{$kind}->($f);
+}
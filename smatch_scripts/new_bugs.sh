@@ -9,29 +9,20 @@ if [ "$old" = "" ] ; then
 fi
 
 #
-# If the $old and $new are very similar then we can 
-# filter out a lot of bug just by doing a diff.
+# The real work is done by the new_bugs program which is built with smatch.
+# It matches warnings on the file, the function and the message so
+# warnings which only moved because the line numbers changed aren't
+# reported.
 #
-# But the line numbers change quite frequently so
-# really we only want to see if the line numbers
-# have changed inside the function.
-# The 42 in this message:
-# file.c +123 some_func(42) warn: blah blah blah
-#
-
-IFS="
-"
-for err in $(diff -u $old $new | cut -b 2- | egrep '(warn|error|warning):') ; do
-
-    # we are only interested in the last chunk.
-    # "some_func(42) warn: blah blah blah"
-    last=$(echo $err | cut -d ' ' -f 2-)
 
-    # There are some error message which include a second
-    # line number so we crudely chop that off.
-    last=$(echo $last | sed -e 's/line .*//')
+SCRIPT_DIR=$(dirname $0)
+if [ -x $SCRIPT_DIR/../new_bugs ] ; then
+    CMD=$SCRIPT_DIR/../new_bugs
+elif which new_bugs > /dev/null 2>&1 ; then
+    CMD=new_bugs
+else
+    echo "new_bugs binary not found.  Run make in the smatch directory."
+    exit 1
+fi
 
-    if ! grep -Fq "$last" $old ; then
-	echo $err
-    fi
-done
+exec $CMD "$new" "$old"
@@ -0,0 +1,310 @@
+/*
+ * smatch/smatch_server.c
+ *
+ * Copyright (C) 2013 Oracle.
+ *
+ * Licensed under the Open Software License version 1.1
+ *
+ */
+
+/*
+ * Starting smatch means loading all the smatch_data/ files, building the
+ * hook tables and opening the DB.  When you run it once per file that is
+ * paid over and over.
+ *
+ * "smatch --server=/path/to/socket [options]" does the startup once and then
+ * waits for requests on a UNIX socket.  "smatch --client=/path/to/socket
+ * [sparse args] file.c" is a drop in replacement for the normal command
+ * line.  It sends its arguments, working directory, stdout and stderr to
+ * the server and the server forks a child which checks the file with the
+ * warm tables.  The warnings are written straight to the client's stdout
+ * as they are found and the client exits with the child's exit status.
+ *
+ * Forking means every request starts from the same clean state and a file
+ * which makes sparse die() doesn't take the server down.  A SQLite handle
+ * can't be shared across fork() so each child opens the DB again.  Requests
+ * are handled one at a time.
+ *
+ * Options which are used at registration time (--project, --data, etc.)
+ * have to be passed to the server.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "smatch.h"
+
+#define MAX_REQUEST_SIZE (1024 * 1024)
+
+static int fill_sockaddr(struct sockaddr_un *addr, const char *path)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path))
+		return -1;
+	strcpy(addr->sun_path, path);
+	return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, p, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t ret;
+
+	while (len) {
+		ret = read(fd, p, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/*
+ * A request is the size of the payload followed by the payload:  the working
+ * directory and then each argument, all NUL terminated.  The client's stdout
+ * and stderr ride along with the size as SCM_RIGHTS.
+ */
+static int send_request(int sock, int argc, char **argv)
+{
+	char cwd[PATH_MAX];
+	char *buf, *p;
+	unsigned int size;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(2 * sizeof(int))];
+	int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+	int i, ret;
+
+	if (!getcwd(cwd, sizeof(cwd)))
+		return -1;
+	size = strlen(cwd) + 1;
+	for (i = 0; i < argc; i++)
+		size += strlen(argv[i]) + 1;
+	if (size > MAX_REQUEST_SIZE)
+		return -1;
+
+	buf = malloc(size);
+	p = buf;
+	strcpy(p, cwd);
+	p += strlen(cwd) + 1;
+	for (i = 0; i < argc; i++) {
+		strcpy(p, argv[i]);
+		p += strlen(argv[i]) + 1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &size;
+	iov.iov_len = sizeof(size);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	ret = -1;
+	if (sendmsg(sock, &msg, 0) == sizeof(size) &&
+	    write_all(sock, buf, size) == 0)
+		ret = 0;
+	free(buf);
+	return ret;
+}
+
+int smatch_client(const char *path, int argc, char **argv)
+{
+	struct sockaddr_un addr;
+	int sock;
+	int status;
+
+	if (fill_sockaddr(&addr, path) < 0) {
+		fprintf(stderr, "smatch: socket path too long: %s\n", path);
+		return 1;
+	}
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "smatch: cannot connect to server %s: %s\n",
+			path, strerror(errno));
+		return 1;
+	}
+	if (send_request(sock, argc, argv) < 0) {
+		fprintf(stderr, "smatch: failed to send request to %s\n", path);
+		return 1;
+	}
+	if (read_all(sock, &status, sizeof(status)) < 0) {
+		fprintf(stderr, "smatch: server %s went away\n", path);
+		return 1;
+	}
+	close(sock);
+	return status;
+}
+
+static char **recv_request(int sock, int *argcp)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(2 * sizeof(int))];
+	int fds[2] = { -1, -1 };
+	unsigned int size;
+	char *buf, *p, *end;
+	char **argv;
+	int argc;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &size;
+	iov.iov_len = sizeof(size);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if (recvmsg(sock, &msg, 0) != sizeof(size))
+		return NULL;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_RIGHTS &&
+		    cmsg->cmsg_len == CMSG_LEN(sizeof(fds)))
+			memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	}
+	if (fds[0] < 0 || fds[1] < 0 || !size || size > MAX_REQUEST_SIZE)
+		return NULL;
+
+	buf = malloc(size);
+	if (read_all(sock, buf, size) < 0 || buf[size - 1] != '\0') {
+		free(buf);
+		return NULL;
+	}
+
+	/* the cwd counts as argv[0] which parse_args() skips anyway */
+	end = buf + size;
+	argc = 0;
+	for (p = buf; p < end; p += strlen(p) + 1)
+		argc++;
+	argv = malloc((argc + 1) * sizeof(*argv));
+	argc = 0;
+	for (p = buf; p < end; p += strlen(p) + 1)
+		argv[argc++] = p;
+	argv[argc] = NULL;
+
+	if (chdir(buf) < 0) {
+		fprintf(stderr, "smatch: server cannot chdir to %s\n", buf);
+		return NULL;
+	}
+	dup2(fds[0], STDOUT_FILENO);
+	dup2(fds[1], STDERR_FILENO);
+	close(fds[0]);
+	close(fds[1]);
+
+	*argcp = argc;
+	return argv;
+}
+
+static void handle_request(int sock)
+{
+	char **argv;
+	int argc;
+
+	/* before recv_request() moves us to the client's directory */
+	reopen_smatch_db();
+	argv = recv_request(sock, &argc);
+	if (!argv)
+		exit(1);
+	close(sock);
+
+	/* warnings should show up in the editor as they are found */
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	sm_outfd = stdout;
+	parse_args(&argc, &argv);
+	smatch(argc, argv);
+	exit(0);
+}
+
+void smatch_server(const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int listener, sock;
+	int status, ret;
+	pid_t pid;
+
+	if (fill_sockaddr(&addr, path) < 0)
+		die("smatch: socket path too long: %s", path);
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0)
+		die("smatch: cannot create socket: %s", strerror(errno));
+	/* clean up after a server which went away, but nothing else */
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode))
+			die("smatch: %s exists and is not a socket", path);
+		unlink(path);
+	}
+	if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(listener, 64) < 0)
+		die("smatch: cannot listen on %s: %s", path, strerror(errno));
+
+	signal(SIGPIPE, SIG_IGN);
+	close_smatch_db();
+	fflush(stdout);
+	fflush(stderr);
+
+	while (1) {
+		sock = accept(listener, NULL, NULL);
+		if (sock < 0) {
+			if (errno == EINTR)
+				continue;
+			die("smatch: accept failed: %s", strerror(errno));
+		}
+
+		pid = fork();
+		if (pid < 0) {
+			close(sock);
+			continue;
+		}
+		if (pid == 0) {
+			close(listener);
+			signal(SIGPIPE, SIG_DFL);
+			handle_request(sock);
+		}
+
+		do {
+			ret = waitpid(pid, &status, 0);
+		} while (ret < 0 && errno == EINTR);
+		if (WIFEXITED(status))
+			status = WEXITSTATUS(status);
+		else
+			status = 128 + WTERMSIG(status);
+		write_all(sock, &status, sizeof(status));
+		close(sock);
+	}
+}
@@ -11,16 +11,64 @@
 #include <stdio.h>
 #include "smatch.h"
 #include "smatch_slist.h"
+#include "smatch_extra.h"
 
 #undef CHECKORDER
 
 ALLOCATOR(smatch_state, "smatch state");
 ALLOCATOR(sm_state, "sm state");
+__DO_ALLOCATOR(struct sm_merge, sizeof(struct sm_merge), __alignof__(struct sm_merge), "sm merge", sm_merge);
 ALLOCATOR(named_slist, "named slist");
+ALLOCATOR(named_table, "named slist table");
 __DO_ALLOCATOR(char, 1, 4, "state names", sname);
 
 static int sm_state_counter;
 
+/*
+ * The possible lists are capped at MAX_POSSIBLE entries.  After that most
+ * owners just stop preserving the unmerged states.  An owner with a
+ * summarize hook instead has the whole list collapsed into one coarser
+ * state so the list stays short and adding to it stays cheap.  That is done
+ * once both sides of a merge are copied in, otherwise whatever was copied
+ * after the summary would be listed next to it.
+ */
+#define MAX_POSSIBLE 100
+
+static unsigned char *preserve_unmerged;
+static merge_func_t **summarize_funcs;
+
+static void alloc_possible_policies(void)
+{
+	if (preserve_unmerged)
+		return;
+	preserve_unmerged = calloc(num_checks + 1, sizeof(*preserve_unmerged));
+	summarize_funcs = calloc(num_checks + 1, sizeof(*summarize_funcs));
+}
+
+void preserve_unmerged_possibles(int owner)
+{
+	alloc_possible_policies();
+	preserve_unmerged[owner] = 1;
+}
+
+void add_summarize_hook(int owner, merge_func_t *func)
+{
+	alloc_possible_policies();
+	summarize_funcs[owner] = func;
+}
+
+static int preserves_unmerged(int owner)
+{
+	return preserve_unmerged && owner <= num_checks && preserve_unmerged[owner];
+}
+
+static merge_func_t *get_summarize_func(int owner)
+{
+	if (!summarize_funcs || owner > num_checks)
+		return NULL;
+	return summarize_funcs[owner];
+}
+
 char *show_sm(struct sm_state *sm)
 {
 	static char buf[256];
@@ -111,16 +159,12 @@ static int cmp_sm_states(const struct sm_state *a, const struct sm_state *b, int
 		return -1;
 	if (a->state < b->state)
 		return 1;
-	/* This is obviously a massive disgusting hack but we need to preserve
-	 * the unmerged states for smatch extra because we use them in
-	 * smatch_db.c.  Meanwhile if we preserve all the other unmerged states
-	 * then it uses a lot of memory and we don't use it.  Hence this hack.
-	 *
-	 * Also sometimes even just preserving every possible SMATCH_EXTRA state
-	 * takes too much resources so we have to cap that.  Capping is probably
-	 * not often a problem in real life.
+	/*
+	 * Owners which asked for it with preserve_unmerged_possibles() keep
+	 * the unmerged states separate (smatch extra needs them for
+	 * smatch_db.c).  Everyone else would just waste memory on them.
 	 */
-	if (a->owner == SMATCH_EXTRA && preserve) {
+	if (preserve) {
 		if (a == b)
 			return 0;
 		if (a->merged == 1 && b->merged == 0)
@@ -146,15 +190,26 @@ static struct sm_state *alloc_sm_state(int owner, const char *name,
 	sm_state->line = get_lineno();
 	sm_state->merged = 0;
 	sm_state->implied = 0;
+	sm_state->summary = 0;
 	sm_state->pool = NULL;
-	sm_state->left = NULL;
-	sm_state->right = NULL;
-	sm_state->nr_children = 1;
+	sm_state->merge = NULL;
 	sm_state->possible = NULL;
-	add_ptr_list(&sm_state->possible, sm_state);
+	add_ptr_list_arena(&sm_state->possible, sm_state);
 	return sm_state;
 }
 
+/* for lists which only sm_states point to:  the pools and possible lists */
+static struct state_list *clone_slist_arena(struct state_list *from_slist)
+{
+	struct sm_state *sm;
+	struct state_list *to_slist = NULL;
+
+	FOR_EACH_PTR(from_slist, sm) {
+		add_ptr_list_arena(&to_slist, sm);
+	} END_FOR_EACH_PTR(sm);
+	return to_slist;
+}
+
 static struct sm_state *alloc_state_no_name(int owner, const char *name,
 				     struct symbol *sym,
 				     struct smatch_state *state)
@@ -168,17 +223,50 @@ static struct sm_state *alloc_state_no_name(int owner, const char *name,
 
 int too_many_possible(struct sm_state *sm)
 {
-	if (ptr_list_size((struct ptr_list *)sm->possible) >= 100)
+	if (ptr_list_size((struct ptr_list *)sm->possible) >= MAX_POSSIBLE)
 		return 1;
 	return 0;
 }
 
+/* some of the paths were folded into a summary so they can't be listed */
+int possible_is_summarized(struct sm_state *sm)
+{
+	struct sm_state *tmp;
+
+	FOR_EACH_PTR(sm->possible, tmp) {
+		if (tmp->summary)
+			return 1;
+	} END_FOR_EACH_PTR(tmp);
+	return 0;
+}
+
+static void summarize_possibles(struct sm_state *to, merge_func_t *summarize)
+{
+	struct smatch_state *state = NULL;
+	struct sm_state *summary;
+	struct sm_state *tmp;
+
+	FOR_EACH_PTR(to->possible, tmp) {
+		if (!state)
+			state = tmp->state;
+		else if (state != tmp->state)
+			state = summarize(state, tmp->state);
+	} END_FOR_EACH_PTR(tmp);
+
+	summary = alloc_state_no_name(to->owner, to->name, to->sym, state);
+	summary->merged = 1;
+	summary->summary = 1;
+	to->possible = NULL;
+	add_ptr_list_arena(&to->possible, summary);
+}
+
 void add_possible_sm(struct sm_state *to, struct sm_state *new)
 {
 	struct sm_state *tmp;
-	int preserve = 1;
+	int preserve;
 
-	if (too_many_possible(to))
+	preserve = preserves_unmerged(to->owner);
+	if (too_many_possible(to) && !get_summarize_func(to->owner))
 		preserve = 0;
 
 	FOR_EACH_PTR(to->possible, tmp) {
@@ -203,6 +291,17 @@ static void copy_possibles(struct sm_state *to, struct sm_state *from)
 	} END_FOR_EACH_PTR(tmp);
 }
 
+static void cap_possibles(struct sm_state *sm)
+{
+	merge_func_t *summarize;
+
+	if (!too_many_possible(sm))
+		return;
+	summarize = get_summarize_func(sm->owner);
+	if (summarize)
+		summarize_possibles(sm, summarize);
+}
+
 char *alloc_sname(const char *str)
 {
 	char *tmp;
@@ -233,47 +332,29 @@ int low_on_memory(void)
 	return 0;
 }
 
-static void free_sm_state(struct sm_state *sm)
-{
-	free_slist(&sm->possible);
-	/*
-	 * fixme.  Free the actual state.
-	 * Right now we leave it until the end of the function
-	 * because we don't want to double free it.
-	 * Use the freelist to not double free things
-	 */
-}
-
-static void free_all_sm_states(struct allocation_blob *blob)
+int sm_state_count(void)
 {
-	unsigned int size = sizeof(struct sm_state);
-	unsigned int offset = 0;
-
-	while (offset < blob->offset) {
-		free_sm_state((struct sm_state *)(blob->data + offset));
-		offset += size;
-	}
+	return sm_state_counter;
 }
 
-/* At the end of every function we free all the sm_states */
-void free_every_single_sm_state(void)
+/*
+ * Everything which only lives as long as the function we are parsing comes
+ * from a handful of allocators:  the sm_states and their names, the
+ * smatch_states, the smatch_extra data and ranges, and the arena ptr lists
+ * which hold the pools, the possible lists and the range lists.  At the end
+ * of the function they are all dropped in one go instead of freeing the
+ * states one at a time.
+ */
+void free_function_arena(void)
 {
-	struct allocator_struct *desc = &sm_state_allocator;
-	struct allocation_blob *blob = desc->blobs;
-
-	desc->blobs = NULL;
-	desc->allocations = 0;
-	desc->total_bytes = 0;
-	desc->useful_bytes = 0;
-	desc->freelist = NULL;
-	while (blob) {
-		struct allocation_blob *next = blob->next;
-		free_all_sm_states(blob);
-		blob_free(blob, desc->chunking);
-		blob = next;
-	}
+	clear_sm_state_alloc();
+	clear_sm_merge_alloc();
+	clear_named_slist_alloc();
+	clear_named_table_alloc();
 	clear_sname_alloc();
 	clear_smatch_state_alloc();
+	free_data_info_allocs();
+	free_ptr_list_arena();
 
 	sm_state_counter = 0;
 }
@@ -285,16 +366,27 @@ struct sm_state *clone_sm(struct sm_state *s)
 	ret = alloc_state_no_name(s->owner, s->name, s->sym, s->state);
 	ret->merged = s->merged;
 	ret->implied = s->implied;
+	ret->summary = s->summary;
 	ret->line = s->line;
 	/* clone_sm() doesn't copy the pools.  Each state needs to have
 	   only one pool. */
-	ret->possible = clone_slist(s->possible);
-	ret->left = s->left;
-	ret->right = s->right;
-	ret->nr_children = s->nr_children;
+	ret->possible = clone_slist_arena(s->possible);
+	/* the merge history never changes so it can be shared */
+	ret->merge = s->merge;
 	return ret;
 }
 
+void set_sm_merge(struct sm_state *sm, struct sm_state *left, struct sm_state *right)
+{
+	struct sm_merge *merge = __alloc_sm_merge(0);
+
+	merge->left = left;
+	merge->right = right;
+	merge->nr_children = (left ? sm_nr_children(left) : 0) +
+			     (right ? sm_nr_children(right) : 0);
+	sm->merge = merge;
+}
+
 int is_merged(struct sm_state *sm)
 {
 	return sm->merged;
@@ -388,11 +480,10 @@ struct sm_state *merge_sm_states(struct sm_state *one, struct sm_state *two)
 	s = merge_states(one->owner, one->name, one->sym, one->state, two->state);
 	result = alloc_state_no_name(one->owner, one->name, one->sym, s);
 	result->merged = 1;
-	result->left = one;
-	result->right = two;
-	result->nr_children = one->nr_children + two->nr_children;
+	set_sm_merge(result, one, two);
 	copy_possibles(result, one);
 	copy_possibles(result, two);
+	cap_possibles(result);
 
 	if (option_debug ||
 	    strcmp(check_name(one->owner), option_debug_check) == 0) {
@@ -706,8 +797,8 @@ void merge_slist(struct state_list **to, struct state_list *slist)
 		return;
 	}
 
-	implied_one = clone_slist(*to);
-	implied_two = clone_slist(slist);
+	implied_one = clone_slist_arena(*to);
+	implied_two = clone_slist_arena(slist);
 
 	match_states(&implied_one, &implied_two);
 
@@ -835,20 +926,61 @@ void or_slist_stack(struct state_list_stack **pre_conds,
 }
 
 /*
- * get_slist_from_named_stack() is only used for gotos.
+ * The named tables are only used for gotos.
  */
-struct state_list **get_slist_from_named_stack(struct named_stack *stack,
-					      const char *name)
+static unsigned int named_hash(const void *key)
+{
+	unsigned long hash = (unsigned long)key;
+
+	hash = (hash >> 4) * 2654435761u;
+	return (hash >> 16) % NAMED_TABLE_SIZE;
+}
+
+struct state_list **get_slist_from_named_table(struct named_table *table,
+					      const void *key)
 {
 	struct named_slist *tmp;
 
-	FOR_EACH_PTR(stack, tmp) {
-		if (!strcmp(tmp->name, name))
+	if (!table)
+		return NULL;
+	for (tmp = table->buckets[named_hash(key)]; tmp; tmp = tmp->next) {
+		if (tmp->key == key)
 			return &tmp->slist;
-	} END_FOR_EACH_PTR(tmp);
+	}
 	return NULL;
 }
 
+void add_slist_to_named_table(struct named_table **table, const void *key,
+			      struct state_list *slist)
+{
+	struct named_slist *named_slist;
+	unsigned int hash = named_hash(key);
+
+	if (!*table) {
+		*table = __alloc_named_table(0);
+		memset(*table, 0, sizeof(**table));
+	}
+	named_slist = __alloc_named_slist(0);
+	named_slist->key = key;
+	named_slist->slist = slist;
+	named_slist->next = (*table)->buckets[hash];
+	(*table)->buckets[hash] = named_slist;
+}
+
+void free_named_table(struct named_table **table)
+{
+	struct named_slist *tmp;
+	int i;
+
+	if (!*table)
+		return;
+	for (i = 0; i < NAMED_TABLE_SIZE; i++) {
+		for (tmp = (*table)->buckets[i]; tmp; tmp = tmp->next)
+			free_slist(&tmp->slist);
+	}
+	*table = NULL;
+}
+
 void overwrite_slist(struct state_list *from, struct state_list **to)
 {
 	struct sm_state *tmp;
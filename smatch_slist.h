@@ -1,11 +1,21 @@
 DECLARE_PTR_LIST(state_list, struct sm_state);
 DECLARE_PTR_LIST(state_list_stack, struct state_list);
 struct named_slist {
-	char *name;
+	const void *key;
 	struct state_list *slist;
+	struct named_slist *next;
 };
 DECLARE_ALLOCATOR(named_slist);
-DECLARE_PTR_LIST(named_stack, struct named_slist);
+
+/*
+ * The states saved for gotos.  Labels are keyed by their symbol and loops
+ * by their statement.
+ */
+#define NAMED_TABLE_SIZE 64
+struct named_table {
+	struct named_slist *buckets[NAMED_TABLE_SIZE];
+};
+DECLARE_ALLOCATOR(named_table);
 
 extern struct state_list_stack *implied_pools;
 extern int __slist_id;
@@ -16,9 +26,10 @@ void add_history(struct sm_state *sm);
 int cmp_tracker(const struct sm_state *a, const struct sm_state *b);
 char *alloc_sname(const char *str);
 
-void free_every_single_sm_state(void);
+void free_function_arena(void);
 struct sm_state *clone_sm(struct sm_state *s);
 int is_merged(struct sm_state *sm);
+void set_sm_merge(struct sm_state *sm, struct sm_state *left, struct sm_state *right);
 int is_implied(struct sm_state *sm);
 struct state_list *clone_slist(struct state_list *from_slist);
 struct state_list_stack *clone_stack(struct state_list_stack *from_stack);
@@ -30,6 +41,7 @@ struct smatch_state *merge_states(int owner, const char *name,
 				  struct smatch_state *state2);
 
 int too_many_possible(struct sm_state *sm);
+int possible_is_summarized(struct sm_state *sm);
 struct sm_state *merge_sm_states(struct sm_state *one, struct sm_state *two);
 struct smatch_state *get_state_slist(struct state_list *slist, int owner, const char *name,
 		    struct symbol *sym);
@@ -63,6 +75,7 @@ struct smatch_state *get_state_stack(struct state_list_stack *stack, int owner,
 
 int out_of_memory(void);
 int low_on_memory(void);
+int sm_state_count(void);
 void merge_slist(struct state_list **to, struct state_list *slist);
 void filter_slist(struct state_list **slist, struct state_list *filter);
 void and_slist_stack(struct state_list_stack **slist_stack);
@@ -71,8 +84,11 @@ void or_slist_stack(struct state_list_stack **pre_conds,
 		    struct state_list *cur_slist,
 		    struct state_list_stack **slist_stack);
 
-struct state_list **get_slist_from_named_stack(struct named_stack *stack,
-					      const char *name);
+struct state_list **get_slist_from_named_table(struct named_table *table,
+					      const void *key);
+void add_slist_to_named_table(struct named_table **table, const void *key,
+			      struct state_list *slist);
+void free_named_table(struct named_table **table);
 
 void overwrite_slist(struct state_list *from, struct state_list **to);
 
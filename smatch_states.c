@@ -52,7 +52,7 @@ static struct range_list_stack *remaining_cases;
 static struct state_list_stack *default_stack;
 static struct state_list_stack *continue_stack;
 
-static struct named_stack *goto_stack;
+static struct named_table *goto_table;
 
 static struct ptr_list *backup;
 
@@ -485,7 +485,7 @@ void save_all_states(void)
 	__add_ptr_list(&backup, default_stack, 0);
 	__add_ptr_list(&backup, continue_stack, 0);
 
-	__add_ptr_list(&backup, goto_stack, 0);
+	__add_ptr_list(&backup, goto_table, 0);
 }
 
 void nullify_all_states(void)
@@ -507,7 +507,7 @@ void nullify_all_states(void)
 	default_stack = NULL;
 	continue_stack = NULL;
 
-	goto_stack = NULL;
+	goto_table = NULL;
 }
 
 static void *pop_backup(void)
@@ -521,7 +521,7 @@ static void *pop_backup(void)
 
 void restore_all_states(void)
 {
-	goto_stack = pop_backup();
+	goto_table = pop_backup();
 
 	continue_stack = pop_backup();
 	default_stack = pop_backup();
@@ -541,10 +541,52 @@ void restore_all_states(void)
 	cur_slist = pop_backup();
 }
 
-void clear_all_states(void)
+/*
+ * The pre-passes in smatch_flow.c start from a copy of the loop head (or
+ * the label) and everything they do is thrown away afterwards except for
+ * the states which make it back around to the top.  For a loop that's
+ * where we ended up, for a label it's what was saved by the gotos.
+ */
+void __start_prepass(struct state_list *head)
 {
-	struct named_slist *named_slist;
+	save_all_states();
+	nullify_all_states();
+	cur_slist = clone_slist(head);
+}
+
+struct state_list *__end_prepass(const void *goto_key)
+{
+	struct state_list **slist;
+	struct state_list *ret = cur_slist;
+
+	if (goto_key) {
+		slist = get_slist_from_named_table(goto_table, goto_key);
+		ret = slist ? *slist : NULL;
+	}
+	restore_all_states();
+	return ret;
+}
+
+/*
+ * Merge the states from a pre-pass into the current states like any other
+ * path which joins here, so the implications between variables still work.
+ * Variables which were only declared further down are left out.
+ */
+void __merge_back_edge(struct state_list *slist)
+{
+	struct state_list *back = NULL;
+	struct sm_state *sm;
+
+	FOR_EACH_PTR(slist, sm) {
+		if (get_sm_state(sm->owner, sm->name, sm->sym))
+			add_ptr_list(&back, sm);
+	} END_FOR_EACH_PTR(sm);
+	merge_slist(&cur_slist, back);
+	free_slist(&back);
+}
 
+void clear_all_states(void)
+{
 	nullify_path();
 	check_stack_free(&true_stack);
 	check_stack_free(&false_stack);
@@ -556,11 +598,7 @@ void clear_all_states(void)
 	check_stack_free(&continue_stack);
 	free_stack_and_slists(&implied_pools);
 
-	FOR_EACH_PTR(goto_stack, named_slist) {
-		free_slist(&named_slist->slist);
-	} END_FOR_EACH_PTR(named_slist);
-	__free_ptr_list((struct ptr_list **)&goto_stack);
-	free_every_single_sm_state();
+	free_named_table(&goto_table);
 }
 
 void __push_cond_stacks(void)
@@ -882,40 +920,27 @@ int __pop_default(void)
 	return 0;
 }
 
-static struct named_slist *alloc_named_slist(const char *name, struct state_list *slist)
-{
-	struct named_slist *named_slist = __alloc_named_slist(0);
-
-	named_slist->name = (char *)name;
-	named_slist->slist = slist;
-	return named_slist;
-}
-
-void __save_gotos(const char *name)
+/*
+ * The key is the label symbol for real gotos and the statement for loops.
+ * merge_slist() doesn't change the list it merges in, so there is no need
+ * to clone cur_slist.
+ */
+void __save_gotos(const void *key)
 {
 	struct state_list **slist;
-	struct state_list *clone;
-
-	slist = get_slist_from_named_stack(goto_stack, name);
-	if (slist) {
-		clone = clone_slist(cur_slist);
-		merge_slist(slist, clone);
-		free_slist(&clone);
-		return;
-	} else {
-		struct named_slist *named_slist;
 
-		clone = clone_slist(cur_slist);
-		named_slist = alloc_named_slist(name, clone);
-		add_ptr_list(&goto_stack, named_slist);
-	}
+	slist = get_slist_from_named_table(goto_table, key);
+	if (slist)
+		merge_slist(slist, cur_slist);
+	else
+		add_slist_to_named_table(&goto_table, key, clone_slist(cur_slist));
 }
 
-void __merge_gotos(const char *name)
+void __merge_gotos(const void *key)
 {
 	struct state_list **slist;
 
-	slist = get_slist_from_named_stack(goto_stack, name);
+	slist = get_slist_from_named_table(goto_table, key);
 	if (slist)
 		merge_slist(&cur_slist, *slist);
 }
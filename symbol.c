@@ -766,15 +766,31 @@ struct symbol	zero_int;
 
 #include "ident-list.h"
 
-void init_symbols(void)
+/*
+ * The built-in idents have to go into the hash table before anything else
+ * creates an ident with the same name, otherwise there would be two idents
+ * for one name.  Users which intern names early (smatch registers its
+ * function hooks by ident) call this before init_symbols() does.
+ */
+void init_builtin_idents(void)
 {
-	int stream = init_stream("builtin", -1, includepath);
-	struct sym_init *ptr;
+	static int done;
+
+	if (done)
+		return;
+	done = 1;
 
 #define __IDENT(n,str,res) \
 	hash_ident(&n)
 #include "ident-list.h"
+}
+
+void init_symbols(void)
+{
+	int stream = init_stream("builtin", -1, includepath);
+	struct sym_init *ptr;
 
+	init_builtin_idents();
 	init_parser(stream);
 
 	builtin_fn_type.variadic = 1;
@@ -277,6 +277,7 @@ extern const char * type_difference(struct ctype *c1, struct ctype *c2,
 
 extern struct symbol *lookup_symbol(struct ident *, enum namespace);
 extern struct symbol *create_symbol(int stream, const char *name, int type, int namespace);
+extern void init_builtin_idents(void);
 extern void init_symbols(void);
 extern void init_ctype(void);
 extern struct symbol *alloc_symbol(struct position, int type);
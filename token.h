@@ -31,6 +31,7 @@ enum constantfile {
 };
 
 extern const char *includepath[];
+extern int include_cache;
 
 struct stream {
 	int fd;
@@ -41,6 +42,7 @@ struct stream {
 	/* Use these to check for "already parsed" */
 	enum constantfile constant;
 	int dirty, next_stream;
+	unsigned int hash;	/* hash_stream() of the name */
 	struct ident *protect;
 	struct token *ifndef;
 	struct token *top_if;
@@ -49,12 +51,16 @@ struct stream {
 extern int input_stream_nr;
 extern struct stream *input_streams;
 extern unsigned int tabstop;
+extern const char *token_cache_dir;
+extern int mmap_input;
 extern int no_lineno;
-extern int *hash_stream(const char *name);
+extern unsigned int hash_stream(const char *name);
+extern int first_hashed_stream(unsigned int hash);
 
 struct ident {
 	struct ident *next;	/* Hash chain of identifiers */
 	struct symbol *symbols;	/* Pointer to semantic meaning list */
+	unsigned int hash;	/* Full hash of the name */
 	unsigned char len;	/* Length of identifier name */
 	unsigned char tainted:1,
 	              reserved:1,
@@ -202,6 +208,7 @@ extern int init_stream(const char *, int fd, const char **next_path);
 extern const char *stream_name(int stream);
 extern struct ident *hash_ident(struct ident *);
 extern struct ident *built_in_ident(const char *);
+extern struct ident *lookup_ident(const char *);
 extern struct token *built_in_token(int, const char *);
 extern const char *show_special(int);
 extern const char *show_ident(const struct ident *);
@@ -15,6 +15,10 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "lib.h"
 #include "allocate.h"
@@ -28,6 +32,8 @@ struct stream *input_streams;
 static int input_streams_allocated;
 unsigned int tabstop = 8;
 int no_lineno = 0;
+const char *token_cache_dir;
+int mmap_input = 1;
 
 #define BUFSIZE (8192)
 
@@ -266,23 +272,71 @@ const char *quote_token(const struct token *token)
 	}
 }
 
-#define HASHED_INPUT_BITS (6)
-#define HASHED_INPUT (1 << HASHED_INPUT_BITS)
-#define HASH_PRIME 0x9e370001UL
+/*
+ * FNV-1a with a final mix so the low bits, which pick the bucket, depend on
+ * every character.  The identifier and the stream tables both use it and
+ * keep the full hash so a chain walk only compares names when it matches.
+ */
+#define name_hash_init(c)		name_hash_add(2166136261u, (c))
+#define name_hash_add(oldhash, c)	(((oldhash) ^ (c)) * 16777619u)
+
+static inline unsigned int name_hash_end(unsigned int hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x7feb352d;
+	hash ^= hash >> 15;
+	return hash;
+}
+
+#define STREAM_HASH_MIN_BITS (6)
 
-static int input_stream_hashes[HASHED_INPUT] = { [0 ... HASHED_INPUT-1] = -1 };
+static int *input_stream_hashes;
+static int stream_hash_bits;
+static int stream_hash_resizes;
 
-int *hash_stream(const char *name)
+unsigned int hash_stream(const char *name)
 {
-	uint32_t hash = 0;
+	unsigned int hash = 2166136261u;
 	unsigned char c;
 
 	while ((c = *name++) != 0)
-		hash = (hash + (c << 4) + (c >> 4)) * 11;
+		hash = name_hash_add(hash, c);
+	return name_hash_end(hash);
+}
 
-	hash *= HASH_PRIME;
-	hash >>= 32 - HASHED_INPUT_BITS;
-	return input_stream_hashes + hash;
+int first_hashed_stream(unsigned int hash)
+{
+	if (!input_stream_hashes)
+		return -1;
+	return input_stream_hashes[hash & ((1 << stream_hash_bits) - 1)];
+}
+
+/* no more than one stream per bucket on average.  Chains stay newest first. */
+static void resize_stream_hash(int nr)
+{
+	int bits = stream_hash_bits ? stream_hash_bits : STREAM_HASH_MIN_BITS;
+	int size, i, *head;
+
+	if (input_stream_hashes && nr <= (1 << bits))
+		return;
+	while ((1 << bits) < nr)
+		bits++;
+	size = 1 << bits;
+
+	if (input_stream_hashes)
+		stream_hash_resizes++;
+	free(input_stream_hashes);
+	input_stream_hashes = malloc(size * sizeof(int));
+	if (!input_stream_hashes)
+		die("Unable to allocate the stream hash");
+	memset(input_stream_hashes, -1, size * sizeof(int));
+	stream_hash_bits = bits;
+
+	for (i = 0; i < input_stream_nr; i++) {
+		head = &input_stream_hashes[input_streams[i].hash & (size - 1)];
+		input_streams[i].next_stream = *head;
+		*head = i;
+	}
 }
 
 int init_stream(const char *name, int fd, const char **next_path)
@@ -297,6 +351,7 @@ int init_stream(const char *name, int fd, const char **next_path)
 			die("Unable to allocate more streams space");
 		input_streams_allocated = newalloc;
 	}
+	resize_stream_hash(stream + 1);
 	current = input_streams + stream;
 	memset(current, 0, sizeof(*current));
 	current->name = name;
@@ -304,8 +359,9 @@ int init_stream(const char *name, int fd, const char **next_path)
 	current->next_path = next_path;
 	current->path = NULL;
 	current->constant = CONSTANT_FILE_MAYBE;
+	current->hash = hash_stream(name);
 	input_stream_nr = stream+1;
-	hash = hash_stream(name);
+	hash = &input_stream_hashes[current->hash & ((1 << stream_hash_bits) - 1)];
 	current->next_stream = *hash;
 	*hash = stream;
 	return stream;
@@ -642,10 +698,42 @@ static int eat_string(int next, stream_t *stream, enum token_type type)
 	return nextchar(stream);
 }
 
+/*
+ * Comments are skipped straight from the buffer up to the next "stop"
+ * character.  Only the line and column are kept up to date, anything
+ * nextchar_slow() has to look at ('\r' and '\\' for line splicing) ends the
+ * scan and the caller carries on with nextchar().
+ */
+static void skip_plain_chars(stream_t *stream, int stop)
+{
+	const unsigned char *buf = stream->buffer;
+	int offset = stream->offset, size = stream->size;
+	int pos = stream->pos;
+	int c;
+
+	for (; offset < size; offset++) {
+		c = buf[offset];
+		if (c == stop || c == '\r' || c == '\\')
+			break;
+		if (c == '\n') {
+			stream->line++;
+			stream->newline = 1;
+			pos = 0;
+		} else if (c == '\t') {
+			pos += tabstop - pos % tabstop;
+		} else {
+			pos++;
+		}
+	}
+	stream->offset = offset;
+	stream->pos = pos;
+}
+
 static int drop_stream_eoln(stream_t *stream)
 {
 	drop_token(stream);
 	for (;;) {
+		skip_plain_chars(stream, '\n');
 		switch (nextchar(stream)) {
 		case EOF:
 			return EOF;
@@ -669,6 +757,8 @@ static int drop_stream_comment(stream_t *stream)
 			warning(stream_pos(stream), "End of file in the middle of a comment");
 			return curr;
 		}
+		if (curr != '*')
+			skip_plain_chars(stream, '*');
 		next = nextchar(stream);
 		if (curr == '*' && next == '/')
 			break;
@@ -790,29 +880,37 @@ static int get_one_special(int c, stream_t *stream)
 	return next;
 }
 
-#define IDENT_HASH_BITS (13)
-#define IDENT_HASH_SIZE (1<<IDENT_HASH_BITS)
-#define IDENT_HASH_MASK (IDENT_HASH_SIZE-1)
+#define IDENT_HASH_MIN_BITS (13)
 
-#define ident_hash_init(c)		(c)
-#define ident_hash_add(oldhash,c)	((oldhash)*11 + (c))
-#define ident_hash_end(hash)		((((hash) >> IDENT_HASH_BITS) + (hash)) & IDENT_HASH_MASK)
+static struct ident **hash_table;
+static int ident_hash_bits;
+static int ident_hit, ident_miss, idents, ident_compares, ident_resizes;
 
-static struct ident *hash_table[IDENT_HASH_SIZE];
-static int ident_hit, ident_miss, idents;
+#define ident_bucket(hash)	(&hash_table[(hash) & ((1 << ident_hash_bits) - 1)])
 
 void show_identifier_stats(void)
 {
 	int i;
 	int distribution[100];
+	int size = 1 << ident_hash_bits;
+
+	fprintf(stderr, "identifiers: %d hits, %d misses, %d name compares\n",
+		ident_hit, ident_miss, ident_compares);
+	fprintf(stderr, "identifiers: %d in %d buckets, load %.2f, %d resizes\n",
+		idents, hash_table ? size : 0,
+		hash_table ? (double)idents / size : 0.0, ident_resizes);
+	fprintf(stderr, "streams: %d in %d buckets, load %.2f, %d resizes\n",
+		input_stream_nr, input_stream_hashes ? 1 << stream_hash_bits : 0,
+		input_stream_hashes ? (double)input_stream_nr / (1 << stream_hash_bits) : 0.0,
+		stream_hash_resizes);
 
-	fprintf(stderr, "identifiers: %d hits, %d misses\n",
-		ident_hit, ident_miss);
+	if (!hash_table)
+		return;
 
 	for (i = 0; i < 100; i++)
 		distribution[i] = 0;
 
-	for (i = 0; i < IDENT_HASH_SIZE; i++) {
+	for (i = 0; i < size; i++) {
 		struct ident * ident = hash_table[i];
 		int count = 0;
 
@@ -831,6 +929,40 @@ void show_identifier_stats(void)
 	}
 }
 
+/*
+ * Double the table when there is more than one identifier per bucket.  The
+ * hash is stored in the ident so nothing is hashed again.
+ */
+static void resize_ident_hash(void)
+{
+	struct ident **old = hash_table;
+	int old_size = old ? 1 << ident_hash_bits : 0;
+	struct ident *ident, *next;
+	int i;
+
+	if (old && idents < old_size)
+		return;
+
+	ident_hash_bits = old ? ident_hash_bits + 1 : IDENT_HASH_MIN_BITS;
+	hash_table = calloc(1 << ident_hash_bits, sizeof(*hash_table));
+	if (!hash_table)
+		die("Unable to allocate the identifier hash");
+	if (!old)
+		return;
+
+	ident_resizes++;
+	for (i = 0; i < old_size; i++) {
+		for (ident = old[i]; ident; ident = next) {
+			struct ident **p = ident_bucket(ident->hash);
+
+			next = ident->next;
+			ident->next = *p;
+			*p = ident;
+		}
+	}
+	free(old);
+}
+
 static struct ident *alloc_ident(const char *name, int len)
 {
 	struct ident *ident = __alloc_ident(len);
@@ -841,51 +973,59 @@ static struct ident *alloc_ident(const char *name, int len)
 	return ident;
 }
 
-static struct ident * insert_hash(struct ident *ident, unsigned long hash)
+static struct ident * insert_hash(struct ident *ident, unsigned int hash)
 {
-	ident->next = hash_table[hash];
-	hash_table[hash] = ident;
+	struct ident **p;
+
+	resize_ident_hash();
+	p = ident_bucket(hash);
+	ident->hash = hash;
+	ident->next = *p;
+	*p = ident;
 	ident_miss++;
+	idents++;
 	return ident;
 }
 
-static struct ident *create_hashed_ident(const char *name, int len, unsigned long hash)
+static struct ident *find_hashed_ident(const char *name, int len, unsigned int hash)
 {
 	struct ident *ident;
-	struct ident **p;
-
-	p = &hash_table[hash];
-	while ((ident = *p) != NULL) {
-		if (ident->len == (unsigned char) len) {
-			if (strncmp(name, ident->name, len) != 0)
-				goto next;
 
-			ident_hit++;
+	if (!hash_table)
+		return NULL;
+	for (ident = *ident_bucket(hash); ident; ident = ident->next) {
+		if (ident->hash != hash || ident->len != (unsigned char) len)
+			continue;
+		ident_compares++;
+		if (strncmp(name, ident->name, len) == 0)
 			return ident;
-		}
-next:
-		//misses++;
-		p = &ident->next;
 	}
-	ident = alloc_ident(name, len);
-	*p = ident;
-	ident->next = NULL;
-	ident_miss++;
-	idents++;
-	return ident;
+	return NULL;
 }
 
-static unsigned long hash_name(const char *name, int len)
+static struct ident *create_hashed_ident(const char *name, int len, unsigned int hash)
 {
-	unsigned long hash;
+	struct ident *ident;
+
+	ident = find_hashed_ident(name, len, hash);
+	if (ident) {
+		ident_hit++;
+		return ident;
+	}
+	return insert_hash(alloc_ident(name, len), hash);
+}
+
+static unsigned int hash_name(const char *name, int len)
+{
+	unsigned int hash;
 	const unsigned char *p = (const unsigned char *)name;
 
-	hash = ident_hash_init(*p++);
+	hash = name_hash_init(*p++);
 	while (--len) {
 		unsigned int i = *p++;
-		hash = ident_hash_add(hash, i);
+		hash = name_hash_add(hash, i);
 	}
-	return ident_hash_end(hash);
+	return name_hash_end(hash);
 }
 
 struct ident *hash_ident(struct ident *ident)
@@ -899,6 +1039,19 @@ struct ident *built_in_ident(const char *name)
 	return create_hashed_ident(name, len, hash_name(name, len));
 }
 
+/*
+ * Like built_in_ident() but never creates a new identifier.  Returns NULL
+ * if nothing by that name has been seen yet.
+ */
+struct ident *lookup_ident(const char *name)
+{
+	int len = strlen(name);
+
+	if (!len)
+		return NULL;
+	return find_hashed_ident(name, len, hash_name(name, len));
+}
+
 struct token *built_in_token(int stream, const char *name)
 {
 	struct token *token;
@@ -914,20 +1067,32 @@ static int get_one_identifier(int c, stream_t *stream)
 {
 	struct token *token;
 	struct ident *ident;
-	unsigned long hash;
+	unsigned int hash;
 	char buf[256];
 	int len = 1;
 	int next;
 
-	hash = ident_hash_init(c);
+	hash = name_hash_init(c);
 	buf[0] = c;
+
+	/* letters and digits are never special to nextchar() */
+	while (stream->offset < stream->size && len < sizeof(buf)) {
+		next = stream->buffer[stream->offset];
+		if (!(cclass[next + 1] & (Letter | Digit)))
+			break;
+		stream->offset++;
+		stream->pos++;
+		hash = name_hash_add(hash, next);
+		buf[len] = next;
+		len++;
+	}
 	for (;;) {
 		next = nextchar(stream);
 		if (!(cclass[next + 1] & (Letter | Digit)))
 			break;
 		if (len >= sizeof(buf))
 			break;
-		hash = ident_hash_add(hash, next);
+		hash = name_hash_add(hash, next);
 		buf[len] = next;
 		len++;
 	};
@@ -941,7 +1106,7 @@ static int get_one_identifier(int c, stream_t *stream)
 							TOKEN_WIDE_STRING);
 		}
 	}
-	hash = ident_hash_end(hash);
+	hash = name_hash_end(hash);
 	ident = create_hashed_ident(buf, len, hash);
 
 	/* Pass it on.. */
@@ -1013,6 +1178,374 @@ struct token * tokenize_buffer(void *buffer, unsigned long size, struct token **
 	return begin;
 }
 
+/*
+ * The on-disk token cache.
+ *
+ * Lexing doesn't look at the macro state at all; that's the preprocessor's
+ * job.  So the token stream of a file only depends on the bytes in it (and
+ * on tabstop and no_lineno, which change the positions).  With
+ * -ftoken-cache=DIR every file we tokenize is saved to DIR under a name
+ * made from a hash of its contents, and the next process which sees the
+ * same contents loads the tokens back instead of lexing again.  Editing a
+ * header changes the hash so stale entries are simply never looked at.
+ *
+ * Streams which produced a warning aren't cached, otherwise the warning
+ * would be lost on the next run.
+ */
+#define TOKEN_CACHE_MAGIC	0x546d5343	/* "CSmT" */
+#define TOKEN_CACHE_VERSION	2
+
+struct token_cache_header {
+	unsigned int magic;
+	unsigned short version;
+	unsigned short pos_size;
+	unsigned int tabstop;
+	unsigned int no_lineno;
+	unsigned long long size;
+	unsigned long long hash;
+	unsigned int nr_tokens;
+	unsigned int data_size;
+};
+
+struct cache_buf {
+	unsigned char *data;
+	unsigned int size, alloc;
+};
+
+static unsigned long long hash_contents(const unsigned char *data, unsigned long size)
+{
+	unsigned long long hash = 0xcbf29ce484222325ULL;	/* FNV-1a */
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static void token_cache_path(char *buf, int len, unsigned long long hash, unsigned long size)
+{
+	snprintf(buf, len, "%s/%016llx-%lx.tok", token_cache_dir, hash, size);
+}
+
+/*
+ * Regular files are mapped and tokenized straight out of the page cache
+ * instead of being copied through a BUFSIZE buffer.  -fno-mmap turns it
+ * off.  Empty files can't be mapped and fall back to read().
+ */
+static unsigned char *map_whole_file(int fd, unsigned long *size)
+{
+	struct stat st;
+	void *data;
+
+	if (!mmap_input || fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return NULL;
+	if (st.st_size <= 0 || st.st_size >= INT_MAX)
+		return NULL;
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return NULL;
+	*size = st.st_size;
+	return data;
+}
+
+static unsigned char *read_whole_file(int fd, unsigned long *size, int *mapped)
+{
+	struct stat st;
+	unsigned char *data;
+	unsigned long done = 0;
+	ssize_t ret;
+
+	data = map_whole_file(fd, size);
+	*mapped = !!data;
+	if (data)
+		return data;
+
+	if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return NULL;
+	if (st.st_size >= INT_MAX)
+		return NULL;
+	data = malloc(st.st_size + 1);
+	if (!data)
+		return NULL;
+	while (done < st.st_size) {
+		ret = read(fd, data + done, st.st_size - done);
+		if (ret < 0) {
+			free(data);
+			lseek(fd, 0, SEEK_SET);
+			return NULL;
+		}
+		if (ret == 0)
+			break;
+		done += ret;
+	}
+	*size = done;
+	return data;
+}
+
+static void free_whole_file(unsigned char *data, unsigned long size, int mapped)
+{
+	if (mapped)
+		munmap(data, size);
+	else
+		free(data);
+}
+
+static void cache_put(struct cache_buf *buf, const void *data, unsigned int len)
+{
+	if (buf->size + len > buf->alloc) {
+		buf->alloc = (buf->size + len) * 2 + 4096;
+		buf->data = realloc(buf->data, buf->alloc);
+		if (!buf->data)
+			die("out of memory in token cache");
+	}
+	memcpy(buf->data + buf->size, data, len);
+	buf->size += len;
+}
+
+static void cache_put_token(struct cache_buf *buf, struct token *token)
+{
+	unsigned char type = token_type(token);
+	struct position pos = token->pos;
+	unsigned char ident_len;
+	unsigned short number_len;
+	unsigned int len;
+
+	pos.stream = 0;
+	cache_put(buf, &type, 1);
+	cache_put(buf, &pos, sizeof(pos));
+
+	switch (type) {
+	case TOKEN_IDENT:
+		ident_len = token->ident->len;
+		cache_put(buf, &ident_len, 1);
+		cache_put(buf, token->ident->name, ident_len);
+		break;
+	case TOKEN_NUMBER:
+		number_len = strlen(token->number) + 1;
+		cache_put(buf, &number_len, sizeof(number_len));
+		cache_put(buf, token->number, number_len);
+		break;
+	case TOKEN_STRING:
+	case TOKEN_WIDE_STRING:
+	case TOKEN_CHAR:
+	case TOKEN_WIDE_CHAR:
+		len = token->string->length;
+		cache_put(buf, &len, sizeof(len));
+		cache_put(buf, token->string->data, len);
+		break;
+	case TOKEN_CHAR_EMBEDDED_0 ... TOKEN_CHAR_EMBEDDED_3:
+	case TOKEN_WIDE_CHAR_EMBEDDED_0 ... TOKEN_WIDE_CHAR_EMBEDDED_3:
+		cache_put(buf, token->embedded, 4);
+		break;
+	case TOKEN_SPECIAL:
+		cache_put(buf, &token->special, sizeof(token->special));
+		break;
+	}
+}
+
+static void save_token_cache(struct token *begin, unsigned long long hash, unsigned long size)
+{
+	struct token_cache_header header;
+	struct cache_buf buf = { NULL, 0, 0 };
+	char path[PATH_MAX], tmp[PATH_MAX + 16];
+	struct token *token;
+	int fd, ok;
+
+	header.nr_tokens = 0;
+	for (token = begin; ; token = token->next) {
+		cache_put_token(&buf, token);
+		header.nr_tokens++;
+		if (token_type(token) == TOKEN_STREAMEND)
+			break;
+	}
+
+	header.magic = TOKEN_CACHE_MAGIC;
+	header.version = TOKEN_CACHE_VERSION;
+	header.pos_size = sizeof(struct position);
+	header.tabstop = tabstop;
+	header.no_lineno = no_lineno;
+	header.size = size;
+	header.hash = hash;
+	header.data_size = buf.size;
+
+	/* Write to a temporary and rename so readers never see half a file */
+	token_cache_path(path, sizeof(path), hash, size);
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		goto free;
+	ok = write(fd, &header, sizeof(header)) == sizeof(header) &&
+	     write(fd, buf.data, buf.size) == buf.size;
+	close(fd);
+	if (!ok || rename(tmp, path) < 0)
+		unlink(tmp);
+free:
+	free(buf.data);
+}
+
+#define CACHE_GET(dst, len)					\
+	do {							\
+		if (p + (len) > end)				\
+			goto corrupt;				\
+		memcpy((dst), p, (len));			\
+		p += (len);					\
+	} while (0)
+
+static struct token *load_token_cache(int idx, unsigned long long hash, unsigned long size,
+				      struct token **endtoken)
+{
+	struct token_cache_header header;
+	char path[PATH_MAX];
+	unsigned char *data, *p, *end;
+	struct token *begin = NULL, **list = &begin;
+	struct token *token = NULL;
+	unsigned char type, ident_len;
+	unsigned short number_len;
+	unsigned int len, i;
+	struct string *string;
+	char *number;
+	int fd;
+
+	token_cache_path(path, sizeof(path), hash, size);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (read(fd, &header, sizeof(header)) != sizeof(header) ||
+	    header.magic != TOKEN_CACHE_MAGIC ||
+	    header.version != TOKEN_CACHE_VERSION ||
+	    header.pos_size != sizeof(struct position) ||
+	    header.tabstop != tabstop ||
+	    header.no_lineno != no_lineno ||
+	    header.size != size || header.hash != hash) {
+		close(fd);
+		return NULL;
+	}
+	data = malloc(header.data_size);
+	if (!data || read(fd, data, header.data_size) != header.data_size) {
+		free(data);
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+
+	p = data;
+	end = data + header.data_size;
+	for (i = 0; i < header.nr_tokens; i++) {
+		token = __alloc_token(0);
+		CACHE_GET(&type, 1);
+		CACHE_GET(&token->pos, sizeof(token->pos));
+		token->pos.stream = idx;
+		token_type(token) = type;
+		token->next = NULL;
+
+		switch (type) {
+		case TOKEN_IDENT:
+			CACHE_GET(&ident_len, 1);
+			if (p + ident_len > end)
+				goto corrupt;
+			token->ident = create_hashed_ident((char *)p, ident_len,
+						hash_name((char *)p, ident_len));
+			p += ident_len;
+			break;
+		case TOKEN_NUMBER:
+			CACHE_GET(&number_len, sizeof(number_len));
+			number = __alloc_bytes(number_len);
+			CACHE_GET(number, number_len);
+			token->number = number;
+			break;
+		case TOKEN_STRING:
+		case TOKEN_WIDE_STRING:
+		case TOKEN_CHAR:
+		case TOKEN_WIDE_CHAR:
+			CACHE_GET(&len, sizeof(len));
+			if (len > MAX_STRING + 1)
+				goto corrupt;
+			string = __alloc_string(len);
+			CACHE_GET(string->data, len);
+			string->length = len;
+			token->string = string;
+			break;
+		case TOKEN_CHAR_EMBEDDED_0 ... TOKEN_CHAR_EMBEDDED_3:
+		case TOKEN_WIDE_CHAR_EMBEDDED_0 ... TOKEN_WIDE_CHAR_EMBEDDED_3:
+			CACHE_GET(token->embedded, 4);
+			break;
+		case TOKEN_SPECIAL:
+			CACHE_GET(&token->special, sizeof(token->special));
+			break;
+		}
+		*list = token;
+		list = &token->next;
+	}
+	if (p != end || !begin || token_type(begin) != TOKEN_STREAMBEGIN ||
+	    token_type(token) != TOKEN_STREAMEND)
+		goto corrupt;
+	free(data);
+
+	eof_token_entry.next = &eof_token_entry;
+	eof_token_entry.pos.newline = 1;
+	token->next = &eof_token_entry;
+	*endtoken = token;
+	return begin;
+
+corrupt:
+	/* The tokens we already allocated are just left for clear_token_alloc() */
+	free(data);
+	unlink(path);
+	return NULL;
+}
+
+static struct token *tokenize_cached(int idx, int fd, struct token **endtoken)
+{
+	struct token *begin, *end;
+	stream_t stream;
+	unsigned long long hash;
+	unsigned char *data;
+	unsigned long size;
+	unsigned int diagnostics;
+	int mapped;
+
+	data = read_whole_file(fd, &size, &mapped);
+	if (!data)
+		return NULL;
+	hash = hash_contents(data, size);
+
+	begin = load_token_cache(idx, hash, size, endtoken);
+	if (begin) {
+		free_whole_file(data, size, mapped);
+		return begin;
+	}
+
+	diagnostics = nr_diagnostics;
+	begin = setup_stream(&stream, idx, -1, data, size);
+	end = tokenize_stream(&stream);
+	if (nr_diagnostics == diagnostics)
+		save_token_cache(begin, hash, size);
+	free_whole_file(data, size, mapped);
+
+	*endtoken = end;
+	return begin;
+}
+
+static struct token *tokenize_mapped(int idx, int fd, struct token **endtoken)
+{
+	struct token *begin;
+	stream_t stream;
+	unsigned char *data;
+	unsigned long size;
+
+	data = map_whole_file(fd, &size);
+	if (!data)
+		return NULL;
+
+	/* the tokens copy everything they need so the mapping can go */
+	begin = setup_stream(&stream, idx, -1, data, size);
+	*endtoken = tokenize_stream(&stream);
+	munmap(data, size);
+	return begin;
+}
+
 struct token * tokenize(const char *name, int fd, struct token *endtoken, const char **next_path)
 {
 	struct token *begin, *end;
@@ -1026,8 +1559,15 @@ struct token * tokenize(const char *name, int fd, struct token *endtoken, const
 		return endtoken;
 	}
 
-	begin = setup_stream(&stream, idx, fd, buffer, 0);
-	end = tokenize_stream(&stream);
+	begin = NULL;
+	if (token_cache_dir)
+		begin = tokenize_cached(idx, fd, &end);
+	if (!begin)
+		begin = tokenize_mapped(idx, fd, &end);
+	if (!begin) {
+		begin = setup_stream(&stream, idx, fd, buffer, 0);
+		end = tokenize_stream(&stream);
+	}
 	if (endtoken)
 		end->next = endtoken;
 	return begin;
@@ -0,0 +1,44 @@
+#include "check_debug.h"
+
+int *get(void);
+
+static inline int helper(int *p)
+{
+	if (p)
+		return 0;
+	return *p;
+}
+
+int one(void)
+{
+	return helper(get());
+}
+
+int two(int a)
+{
+	__smatch_implied(a);
+	return helper(get());
+}
+
+int three(int a)
+{
+	if (a < 10)
+		return -1;
+	__smatch_implied(a);
+	return 0;
+}
+
+int four(void)
+{
+	return helper(0);
+}
+/*
+ * check-name: smatch --jobs #1
+ * check-command: smatch --jobs=3 -I.. sm_jobs1.c
+ *
+ * check-output-start
+sm_jobs1.c:9 helper() error: we previously assumed 'p' could be null (see line 7)
+sm_jobs1.c:19 two() implied: a = 's32min-s32max'
+sm_jobs1.c:27 three() implied: a = '10-s32max'
+ * check-output-end
+ */
@@ -0,0 +1,37 @@
+#include "check_debug.h"
+
+int frob(void);
+
+void func(void)
+{
+	int x = 0;
+	int y = 5;
+	int z = 0;
+
+	while (frob()) {
+		__smatch_value("x");
+		__smatch_value("y");
+		x++;
+		if (frob())
+			z = 3;
+	}
+	__smatch_value("x");
+	__smatch_value("z");
+
+	do {
+		__smatch_value("y");
+		y--;
+	} while (frob());
+}
+/*
+ * check-name: smatch loops #5
+ * check-command: smatch -I.. sm_loops5.c
+ *
+ * check-output-start
+sm_loops5.c:12 func() x = 0-s32max
+sm_loops5.c:13 func() y = 5
+sm_loops5.c:18 func() x = 0-s32max
+sm_loops5.c:19 func() z = 0,3
+sm_loops5.c:22 func() y = s32min-5
+ * check-output-end
+ */
@@ -0,0 +1,26 @@
+struct foo {
+	int a;
+};
+
+struct foo *get(int i);
+
+void func(int n)
+{
+	struct foo *p;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		p = get(i);
+		if (p)
+			p->a = 1;
+		p->a = 2;
+	}
+}
+/*
+ * check-name: smatch loops #6
+ * check-command: smatch sm_loops6.c
+ *
+ * check-output-start
+sm_loops6.c:16 func() error: we previously assumed 'p' could be null (see line 14)
+ * check-output-end
+ */
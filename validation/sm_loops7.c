@@ -0,0 +1,30 @@
+struct stmt {
+	int a;
+	struct stmt *next;
+};
+
+int cost(struct stmt *s);
+
+int func(struct stmt *args, struct stmt *list)
+{
+	struct stmt *s, *last;
+	int statements;
+
+	last = args;
+	statements = last != 0;
+	for (s = list; s; s = s->next) {
+		statements++;
+		last = s;
+	}
+
+	if (statements == 1)
+		return last->a;
+	return 0;
+}
+/*
+ * check-name: smatch loops #7
+ * check-command: smatch sm_loops7.c
+ *
+ * check-output-start
+ * check-output-end
+ */
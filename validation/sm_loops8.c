@@ -0,0 +1,44 @@
+struct expr {
+	int flags;
+	int op;
+	struct expr *down;
+};
+
+struct expr *alloc_expr(void);
+int next_token(void);
+
+void func(struct expr **p)
+{
+	struct expr *e;
+	int token;
+
+	for (;;) {
+		token = next_token();
+		switch (token) {
+		case 1:
+			return;
+		case 2:
+			e = alloc_expr();
+			e->flags = 1;
+			e->op = '[';
+			*p = e;
+			p = &e->down;
+			/* fall through */
+		case 3:
+			e = alloc_expr();
+			e->flags = 1;
+			e->op = '.';
+			*p = e;
+			p = &e->down;
+			break;
+		}
+	}
+}
+/*
+ * check-name: smatch loops #8
+ * check-command: smatch sm_loops8.c
+ *
+ * check-output-start
+sm_loops8.c:29 func() warn: missing break? reassigning 'e->flags'
+ * check-output-end
+ */
@@ -0,0 +1,18 @@
+struct foo {
+	int a;
+};
+
+void func(struct foo *p)
+{
+	if (p)
+		p->a = 1;
+	p->a = 2;
+}
+/*
+ * check-name: smatch server #1
+ * check-command: validation/smatch-server-run $tmpdir/sock sm_server1.c
+ *
+ * check-output-start
+sm_server1.c:9 func() error: we previously assumed 'p' could be null (see line 7)
+ * check-output-end
+ */
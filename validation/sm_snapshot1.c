@@ -0,0 +1,27 @@
+#ifndef SM_SNAPSHOT1_ONCE
+#define SM_SNAPSHOT1_ONCE
+
+static int limit(int a)
+{
+	if (a > 100)
+		return 100;
+	return a;
+}
+
+#endif
+
+int frob(int a)
+{
+	a = limit(a);
+	__smatch_implied(a);
+	return a;
+}
+/*
+ * check-name: smatch --snapshot #1
+ * check-command: smatch --snapshot -I.. -include check_debug.h sm_snapshot1.c sm_snapshot1.c
+ *
+ * check-output-start
+sm_snapshot1.c:16 frob() implied: a = '100'
+sm_snapshot1.c:16 frob() implied: a = '100'
+ * check-output-end
+ */
@@ -0,0 +1,62 @@
+#include "check_debug.h"
+
+int frob(void);
+
+#define SET(n) if (frob()) x = n
+#define SET10(n) SET(n##0); SET(n##1); SET(n##2); SET(n##3); SET(n##4); \
+		 SET(n##5); SET(n##6); SET(n##7); SET(n##8); SET(n##9)
+
+void func(void)
+{
+	int x = 1000;
+
+	SET10(1);
+	__smatch_implied(x);
+	SET10(2);
+	SET10(3);
+	SET10(4);
+	SET10(5);
+	SET10(6);
+	SET10(7);
+	SET10(8);
+	SET10(9);
+	SET10(10);
+	SET10(11);
+	__smatch_implied(x);
+	__smatch_possible("x");
+	if (x < 50)
+		__smatch_implied(x);
+}
+/*
+ * check-name: smatch summarize possibles #1
+ * check-command: smatch -I.. sm_summarize1.c
+ *
+ * check-output-start
+sm_summarize1.c:14 func() implied: x = '10-19,1000'
+sm_summarize1.c:25 func() implied: x = '10-119,1000'
+sm_summarize1.c:26 func() Possible values for x
+10-119,1000
+119
+10-118,1000
+118
+10-117,1000
+117
+10-116,1000
+116
+10-115,1000
+115
+10-114,1000
+114
+10-113,1000
+113
+10-112,1000
+112
+10-111,1000
+111
+10-110,1000
+110
+10-1000
+sm_summarize1.c:26 func() ===
+sm_summarize1.c:28 func() implied: x = '10-49'
+ * check-output-end
+ */
@@ -0,0 +1,27 @@
+#include "check_debug.h"
+
+int frob(void);
+void *get(void);
+
+void func(void)
+{
+	int *p;
+	int tries = 0;
+
+again:
+	__smatch_value("tries");
+	tries = 3;
+	if (frob())
+		goto again;
+	p = get();
+	if (!p)
+		goto again;
+}
+/*
+ * check-name: smatch --two-passes #1
+ * check-command: smatch --two-passes -I.. sm_two_passes1.c
+ *
+ * check-output-start
+sm_two_passes1.c:12 func() tries = 0,3
+ * check-output-end
+ */
@@ -0,0 +1,44 @@
+#include "check_debug.h"
+
+int frob(void);
+
+struct foo {
+	int a;
+};
+
+struct foo *get(int i);
+
+void func(void)
+{
+	int tries = 0;
+
+	({
+again:
+		__smatch_value("tries");
+		tries = 3;
+		if (frob())
+			goto again;
+	});
+}
+
+void func2(int n)
+{
+	struct foo *p;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		p = get(i);
+		if (p)
+			p->a = 1;
+		p->a = 2;
+	}
+}
+/*
+ * check-name: smatch --two-passes #2
+ * check-command: smatch --two-passes -I.. sm_two_passes2.c
+ *
+ * check-output-start
+sm_two_passes2.c:17 func() tries = 0,3
+sm_two_passes2.c:33 func2() error: we previously assumed 'p' could be null (see line 31)
+ * check-output-end
+ */
@@ -0,0 +1,17 @@
+static int x = 'abcde';
+static int y = L'abcde';
+static int z = 'ab';
+static const char *s = "abcde";
+/*
+ * check-name: token cache with character constants
+ * check-command: sparse -ftoken-cache=$tmpdir $file $file
+ *
+ * check-error-start
+token-cache1.c:1:16: warning: multi-character character constant
+token-cache1.c:2:16: warning: multi-character character constant
+token-cache1.c:3:16: warning: multi-character character constant
+token-cache1.c:1:16: warning: multi-character character constant
+token-cache1.c:2:16: warning: multi-character character constant
+token-cache1.c:3:16: warning: multi-character character constant
+ * check-error-end
+ */